@@ -0,0 +1,89 @@
+#!/usr/bin/env python3
+# -*- coding:utf-8 -*-
+'''
+Copyright (c) 2025
+See the accompanying Manual for the contributors and the way to
+cite this work. Comments and suggestions welcome. Please contact
+Dr. Guanghong Zuo <ghzuo@ucas.ac.cn>
+'''
+
+
+import argparse
+import os
+import shutil
+import subprocess
+import tempfile
+import time
+
+
+def parseArgs():
+    # default options
+    parser = argparse.ArgumentParser(
+        description='Time the kmer counters of cvnet and compare their CVAs')
+    parser.add_argument('-b', '--bindir', type=str, default='build/bin',
+                        help="The directory of cvnet and dump")
+    parser.add_argument('-i', '--list', type=str, default='list',
+                        help="The genome file list")
+    parser.add_argument('-G', '--gndir', type=str, default='',
+                        help="The directory for genome files, "
+                        "default the directory of list")
+    parser.add_argument('-v', '--method', nargs='+', type=str,
+                        default=['Count', 'Hao'], help="The CV methods")
+    parser.add_argument('-k', '--kmer', nargs='+', type=str,
+                        default=['3', '5', '7'], help="The kmer lengths")
+    parser.add_argument('-c', '--counter', nargs='+', type=str,
+                        default=['hash', 'sort', 'auto'],
+                        help="The counters, the first one is the reference")
+    parser.add_argument('-r', '--repeat', type=int, default=3,
+                        help="The number of runs for the best time")
+    return parser.parse_args()
+
+
+def runCVA(args, wdir, meth, k, counter):
+    # the cva of all genomes in a new cache, the best time of the runs
+    cmd = [os.path.join(args.bindir, 'cvnet'), '-q', '-B', 'cva',
+           '-i', os.path.abspath(args.list), '-v', meth, '-k', k,
+           '--counter', counter, '-C', wdir,
+           '-G', os.path.abspath(args.gndir) + '/']
+    best = float('inf')
+    for _ in range(args.repeat):
+        shutil.rmtree(os.path.join(wdir, 'cva'), ignore_errors=True)
+        start = time.perf_counter()
+        subprocess.run(cmd, check=True, cwd=wdir, stdout=subprocess.DEVNULL)
+        best = min(best, time.perf_counter() - start)
+
+    # the dumps of the cva files by the file name, without the gene tails
+    dumps = {}
+    cvadir = os.path.join(wdir, 'cva')
+    for name in sorted(os.listdir(cvadir)):
+        if '.tail.' in name:
+            continue
+        out = subprocess.run([os.path.join(args.bindir, 'dump'), '-v',
+                              os.path.join(cvadir, name)], check=True,
+                             capture_output=True)
+        dumps[name] = out.stdout
+    return best, dumps
+
+
+if __name__ == "__main__":
+    args = parseArgs()
+    args.bindir = os.path.abspath(args.bindir)
+    if not args.gndir:
+        args.gndir = os.path.dirname(os.path.abspath(args.list))
+
+    ndiff = 0
+    print("method\tk\tcounter\ttime(s)\tCVA")
+    for meth in args.method:
+        for k in args.kmer:
+            ref = None
+            for counter in args.counter:
+                with tempfile.TemporaryDirectory() as wdir:
+                    sec, dumps = runCVA(args, wdir, meth, k, counter)
+                if ref is None:
+                    ref, same = dumps, 'reference'
+                elif dumps == ref:
+                    same = 'same'
+                else:
+                    same, ndiff = 'DIFF', ndiff + 1
+                print(f"{meth}\t{k}\t{counter}\t{sec:.3f}\t{same}")
+    exit(1 if ndiff > 0 else 0)
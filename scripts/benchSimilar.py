@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+# -*- coding:utf-8 -*-
+'''
+Copyright (c) 2025
+See the accompanying Manual for the contributors and the way to
+cite this work. Comments and suggestions welcome. Please contact
+Dr. Guanghong Zuo <ghzuo@ucas.ac.cn>
+'''
+
+
+import argparse
+import hashlib
+import os
+import re
+import shutil
+import subprocess
+import tempfile
+
+
+def parseArgs():
+    # default options
+    parser = argparse.ArgumentParser(
+        description='Time the similarity methods of cvnet on the same CVAs')
+    parser.add_argument('-b', '--bindir', type=str, default='build/bin',
+                        help="The directory of cvnet and dump")
+    parser.add_argument('-i', '--list', type=str, default='example/list',
+                        help="The genome file list")
+    parser.add_argument('-G', '--gndir', type=str, default='',
+                        help="The directory for genome files, "
+                        "default the directory of list")
+    parser.add_argument('-v', '--method', type=str, default='Hao',
+                        help="The CV method")
+    parser.add_argument('-k', '--kmer', type=str, default='5',
+                        help="The kmer length")
+    parser.add_argument('-s', '--similar', nargs='+', type=str,
+                        default=['Cosine', 'Euclidean', 'InterList',
+                                 'Min2Max', 'InterSet', 'Jaccard', 'Dice'],
+                        help="The similarity methods")
+    parser.add_argument('-r', '--repeat', type=int, default=3,
+                        help="The number of runs for the best time")
+    return parser.parse_args()
+
+
+def cvnet(args, wdir, *opts):
+    # run cvnet on the cache in wdir, and return its log of the sections
+    cmd = [os.path.join(args.bindir, 'cvnet'), '-i',
+           os.path.abspath(args.list), '-v', args.method, '-k', args.kmer,
+           '-C', wdir, '-O', os.path.join(wdir, 'out'),
+           '-G', os.path.abspath(args.gndir) + '/'] + list(opts)
+    out = subprocess.run(cmd, check=True, cwd=wdir, capture_output=True,
+                         text=True)
+    return out.stderr
+
+
+def runSimilar(args, wdir, meth):
+    # the best time of the similarity step, and the digest of the network
+    best = float('inf')
+    for _ in range(args.repeat):
+        shutil.rmtree(os.path.join(wdir, 'sm'), ignore_errors=True)
+        shutil.rmtree(os.path.join(wdir, 'out'), ignore_errors=True)
+        log = cvnet(args, wdir, '-s', meth)
+        sec = re.search(r'Get All Similar Matrix.*?Time Elapsed: ([\d.]+) s',
+                        log, re.S)
+        best = min(best, float(sec.group(1)))
+
+    md5 = hashlib.md5()
+    outdir = os.path.join(wdir, 'out')
+    for name in sorted(os.listdir(outdir)):
+        if name.endswith('.mcl'):
+            with open(os.path.join(outdir, name), 'rb') as f:
+                md5.update(f.read())
+    return best, md5.hexdigest()
+
+
+if __name__ == "__main__":
+    args = parseArgs()
+    args.bindir = os.path.abspath(args.bindir)
+    if not args.gndir:
+        args.gndir = os.path.dirname(os.path.abspath(args.list))
+
+    # the CVAs are obtained once, and shared by all similarity methods
+    with tempfile.TemporaryDirectory() as wdir:
+        cvnet(args, wdir, '-q', '-B', 'cva')
+        print("method\tk\tsimilarity\ttime(s)\tnetwork")
+        for meth in args.similar:
+            sec, md5 = runSimilar(args, wdir, meth)
+            print(f"{args.method}\t{args.kmer}\t{meth}\t{sec:.3f}\t{md5}")
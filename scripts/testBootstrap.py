@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+# -*- coding:utf-8 -*-
+'''
+Copyright (c) 2025
+See the accompanying Manual for the contributors and the way to
+cite this work. Comments and suggestions welcome. Please contact
+Dr. Guanghong Zuo <ghzuo@ucas.ac.cn>
+'''
+
+
+import argparse
+import gzip
+import os
+import subprocess
+import tempfile
+
+
+def parseArgs():
+    # default options
+    parser = argparse.ArgumentParser(
+        description='Check the bootstrap CVs resumed with a part of k cached '
+        'against the ones of a full run')
+    parser.add_argument('-b', '--bindir', type=str, default='build/bin',
+                        help="The directory of cvnet")
+    parser.add_argument('-i', '--list', type=str, default='example/list',
+                        help="The genome file list")
+    parser.add_argument('-G', '--gndir', type=str, default='',
+                        help="The directory for genome files, "
+                        "default the directory of list")
+    parser.add_argument('-v', '--method', nargs='+', type=str,
+                        default=['Count', 'Hao'], help="The CV methods")
+    parser.add_argument('-k', '--kmer', type=str, default='12,13',
+                        help="The kmer lengths, across the longest one of "
+                        "the packed kstring by default")
+    parser.add_argument('-d', '--drop', type=str, default='12',
+                        help="The kmer length of the replicates removed "
+                        "before the resumed run")
+    parser.add_argument('-n', '--nboot', type=str, default='2',
+                        help="The number of replicates")
+    return parser.parse_args()
+
+
+def bootstrap(args, wdir, meth):
+    # the replicates of the genomes in the cache of wdir
+    cmd = [os.path.join(args.bindir, 'cvnet'), '-q', '-B', 'cva',
+           '-i', os.path.abspath(args.list), '-v', meth, '-k', args.kmer,
+           '--bootstrap', args.nboot, '-C', wdir,
+           '-G', os.path.abspath(args.gndir) + '/']
+    subprocess.run(cmd, check=True, cwd=wdir, stdout=subprocess.DEVNULL)
+
+
+def replicates(wdir, suffix):
+    # the contents of the replicate files with the suffix
+    cvs = {}
+    bootdir = os.path.join(wdir, 'cva', 'boot')
+    for root, _, files in os.walk(bootdir):
+        for name in files:
+            if name.endswith(suffix):
+                fname = os.path.join(root, name)
+                with gzip.open(fname, 'rb') as f:
+                    cvs[os.path.relpath(fname, bootdir)] = f.read()
+    return cvs
+
+
+if __name__ == "__main__":
+    args = parseArgs()
+    args.bindir = os.path.abspath(args.bindir)
+    if not args.gndir:
+        args.gndir = os.path.dirname(os.path.abspath(args.list))
+
+    # the replicates of a length are removed and got again with the others
+    # kept in the cache
+    ndiff = 0
+    for meth in args.method:
+        suffix = '.' + meth + args.drop + '.gz'
+        with tempfile.TemporaryDirectory() as wdir:
+            bootstrap(args, wdir, meth)
+            full = replicates(wdir, suffix)
+            for name in full:
+                os.remove(os.path.join(wdir, 'cva', 'boot', name))
+            bootstrap(args, wdir, meth)
+            resumed = replicates(wdir, suffix)
+        if not full:
+            exit(f"No replicate of {meth} at k={args.drop}")
+        for name in full:
+            if resumed.get(name) != full[name]:
+                print(f"DIFF: {name}")
+                ndiff += 1
+        print(f"{meth}: {len(full)} replicates checked")
+
+    if ndiff > 0:
+        print(f"FAILED: {ndiff} replicates differ")
+        exit(1)
+    print("PASSED")
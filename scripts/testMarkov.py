@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+# -*- coding:utf-8 -*-
+'''
+Copyright (c) 2025
+See the accompanying Manual for the contributors and the way to
+cite this work. Comments and suggestions welcome. Please contact
+Dr. Guanghong Zuo <ghzuo@ucas.ac.cn>
+'''
+
+
+import argparse
+import os
+import subprocess
+import tempfile
+
+from benchCounter import runCVA
+
+
+def parseArgs():
+    # default options
+    parser = argparse.ArgumentParser(
+        description='Check the Markov subtraction of Hao by the counters of '
+        'cvnet against the one of a reference build, such as the one before '
+        'the merge-based subtraction')
+    parser.add_argument('-b', '--bindir', type=str, default='build/bin',
+                        help="The directory of cvnet and dump")
+    parser.add_argument('-r', '--refdir', type=str, required=True,
+                        help="The directory of cvnet and dump of the "
+                        "reference build, e.g. by `git worktree add ref "
+                        "<commit>` and the cmake build of ref/src")
+    parser.add_argument('-i', '--list', type=str, default='example/list',
+                        help="The genome file list")
+    parser.add_argument('-G', '--gndir', type=str, default='',
+                        help="The directory for genome files, "
+                        "default the directory of list")
+    parser.add_argument('-k', '--kmer', nargs='+', type=str,
+                        default=['3', '5', '8', '13'],
+                        help="The kmer lengths, the ones above 12 are by the "
+                        "Kstr of any length")
+    parser.add_argument('-c', '--counter', nargs='+', type=str,
+                        default=['hash', 'sort'], help="The counters")
+    return parser.parse_args()
+
+
+def genomes(args):
+    # the genome files of the list
+    with open(args.list) as f:
+        return [ln.split()[0] for ln in f if ln.strip()]
+
+
+def refCVA(args, wdir, k):
+    # the dumps of the reference cva by the genome files, they are named by
+    # the genome files in the cache of reference
+    cmd = [os.path.join(args.refdir, 'cvnet'), '-q', '-B', 'cva',
+           '-i', os.path.abspath(args.list), '-v', 'Hao', '-k', k,
+           '-C', wdir, '-G', os.path.abspath(args.gndir) + '/']
+    subprocess.run(cmd, check=True, cwd=wdir, stdout=subprocess.DEVNULL)
+    dumps = {}
+    for gn in genomes(args):
+        fname = os.path.join(wdir, 'cva', os.path.basename(gn) + '.Hao' + k)
+        if not os.path.exists(fname):
+            fname += '.gz'
+        out = subprocess.run([os.path.join(args.refdir, 'dump'), '-v', fname],
+                             check=True, capture_output=True)
+        if not out.stdout:
+            exit(f"Empty reference CVA: {fname}")
+        dumps[gn] = out.stdout
+    return dumps
+
+
+def newCVA(args, k, counter):
+    # the dumps of the cva by the genome files, by the hashes of genomes in
+    # the cache
+    with tempfile.TemporaryDirectory() as wdir:
+        _, dumps = runCVA(args, wdir, 'Hao', k, counter)
+        hashes = {}
+        with open(os.path.join(wdir, 'GenomeHash.tsv')) as f:
+            for ln in f:
+                path, _, _, key = ln.split()
+                hashes[os.path.realpath(path)] = key
+    byGenome = {}
+    for gn in genomes(args):
+        path = os.path.realpath(os.path.join(args.gndir, gn))
+        name = hashes.get(path, '') + '.' + gn.split('.')[-1] + '.Hao' + k
+        byGenome[gn] = dumps.get(name)
+    return byGenome
+
+
+if __name__ == "__main__":
+    args = parseArgs()
+    args.bindir = os.path.abspath(args.bindir)
+    args.refdir = os.path.abspath(args.refdir)
+    if not args.gndir:
+        args.gndir = os.path.dirname(os.path.abspath(args.list))
+    args.repeat = 1
+
+    # the CVAs of the reference build are the ones to be matched
+    ndiff = 0
+    for k in args.kmer:
+        with tempfile.TemporaryDirectory() as wdir:
+            ref = refCVA(args, wdir, k)
+        for counter in args.counter:
+            dumps = newCVA(args, k, counter)
+            for gn in ref:
+                if dumps[gn] != ref[gn]:
+                    print(f"DIFF: {gn} at k={k} by {counter}")
+                    ndiff += 1
+        print(f"Hao k={k}: {len(ref)} CVAs checked")
+
+    if ndiff > 0:
+        print(f"FAILED: {ndiff} CVAs differ")
+        exit(1)
+    print("PASSED")
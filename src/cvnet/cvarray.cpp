@@ -13,9 +13,20 @@
 #include "cvarray.h"
 // for CV array info/header
 void CVAinfo::read(const string &fname) {
+  // the header of the uncompressed file
+  string base = cvabase(fname);
+  MMapFile mf;
+  if (mf.open(base) && mf.size >= sizeof(CVAHeader)) {
+    const CVAHeader &hd = *(const CVAHeader *)mf.data;
+    if (hd.valid(mf.size)) {
+      *this = CVAinfo(hd);
+      return;
+    }
+  }
+
   // open and test file
   gzFile fp;
-  string gzfile = addsuffix(fname, ".gz");
+  string gzfile = base + ".gz";
   if ((fp = gzopen(gzfile.c_str(), "rb")) == NULL) {
     cerr << "CV file not found: \"" << gzfile << '"' << endl;
     exit(1);
@@ -32,60 +43,367 @@ ostream &operator<<(ostream &os, const CVAinfo &hd) {
 };
 
 void CVArray::set(const vector<CVvec> &cvs) {
-  // get the cvdiminfo
+  vector<mlong> kstrs;
+  vector<Kitem> its;
+  scatter(cvs, kstrs, its);
+  post.set(kstrs, its);
+};
+
+// release the CVs once their items are collected
+void CVArray::set(vector<CVvec> &&cvs) {
+  vector<mlong> kstrs;
+  vector<Kitem> its;
+  scatter(cvs, kstrs, its);
+  vector<CVvec>().swap(cvs);
+  post.set(kstrs, its);
+};
+
+// collect the items of all CVs with their kstrs, bucketed by the high byte of
+// kstr and every bucket stable sorted by the rest bits. So the items are
+// sorted by kstr and keep the order of CV, and only a bucket is buffered.
+void CVArray::scatter(const vector<CVvec> &cvs, vector<mlong> &kstrs,
+                      vector<Kitem> &data) {
+  // get the cvdiminfo, the number of items and the max kstr
+  size_t nitem(0);
+  mlong kmax(0);
   for (const auto &cv : cvs) {
     cvdi.emplace_back(CVdimInfo(cv));
+    nitem += cv.size();
+    if (!cv.empty())
+      kmax = max(kmax, cv.back().first.ks);
   }
 
-  // align kstr into map
-  map<Kstr, vector<Kitem>> kmap;
-  for (auto i = 0; i < cvs.size(); ++i) {
-    auto cv = cvs[i];
+  // the position of buckets
+  size_t nbit = nbitOf(kmax);
+  size_t sh = nbit > 8 ? nbit - 8 : 0;
+  vector<size_t> pos(257, 0);
+  for (const auto &cv : cvs)
+    for (const auto &cd : cv)
+      ++pos[(cd.first.ks >> sh) + 1];
+  for (size_t i = 1; i < pos.size(); ++i)
+    pos[i] += pos[i - 1];
+
+  // scatter items into buckets in the order of CV
+  data.resize(nitem);
+  kstrs.resize(nitem);
+  int ndx = cvdi.size() - cvs.size();
+  vector<size_t> iter(pos.begin(), pos.end() - 1);
+  for (const auto &cv : cvs) {
     for (const auto &cd : cv) {
-      kmap[cd.first].emplace_back(Kitem(i, cd.second));
+      size_t i = iter[cd.first.ks >> sh]++;
+      kstrs[i] = cd.first.ks;
+      data[i] = Kitem(ndx, cd.second);
     }
+    ++ndx;
   }
 
-  // set CVArray based on map
-  for (auto &kar : kmap) {
-    size_t ibeg = data.size();
-    size_t iend = ibeg + kar.second.size();
-    kdi.emplace_back(KdimInfo(kar.first, ibeg, iend));
-    data.insert(data.end(), kar.second.begin(), kar.second.end());
+  // sort every bucket by the rest bits, buckets are shared by threads when
+  // it is not called in a parallel region
+#pragma omp parallel
+  {
+    vector<pair<mlong, Kitem>> bucket, buf;
+#pragma omp for schedule(dynamic)
+    for (size_t b = 0; b < pos.size() - 1; ++b) {
+      if (pos[b + 1] - pos[b] < 2)
+        continue;
+      bucket.clear();
+      for (size_t i = pos[b]; i < pos[b + 1]; ++i)
+        bucket.emplace_back(kstrs[i], data[i]);
+      radixSort(bucket, buf, sh,
+                [](const pair<mlong, Kitem> &a) { return a.first; });
+      for (size_t i = pos[b]; i < pos[b + 1]; ++i) {
+        kstrs[i] = bucket[i - pos[b]].first;
+        data[i] = bucket[i - pos[b]].second;
+      }
+    }
   }
 };
 
 void CVArray::setNorm(enum LPnorm lp) {
-  norm.reserve(cvdi.size());
+  this->lp = lp;
+  auto cds = cvdims();
+  norm.reserve(cds.size());
   switch (lp) {
   case L0:
-    for (auto &ci : cvdi)
+    for (auto &ci : cds)
       norm.emplace_back(ci.len);
     break;
   case L1:
-    for (auto &ci : cvdi)
+    for (auto &ci : cds)
       norm.emplace_back(ci.lasso);
     break;
   case L2:
-    for (auto &ci : cvdi)
+    for (auto &ci : cds)
       norm.emplace_back(ci.norm);
     break;
   }
   cvdi.clear();
 };
 
-Kblock CVArray::getKblock(size_t ndx) const {
-  auto _beg = data.begin() + kdi[ndx].index.first;
-  auto _end = data.begin() + kdi[ndx].index.second;
-  Kblock kb(_beg, _end);
-  return kb;
+// set the postings for the similarity. The postings viewed in the mapped file
+// keep the mapping, and the cvdiminfo is released. The kstrs in more than
+// maxdf genes are dropped, and out of the norms. The items by genes are only
+// for the matrix by rows, which needs the norms not signed
+void CVArray::setPost(const KDict *dict, const string &fname, size_t maxdf,
+                      bool genes) {
+  vector<Kitem> drop;
+  if (maxdf > 0)
+    post.cap(maxdf, drop);
+  if (!drop.empty())
+    capNorm(drop);
+  if (genes && !signedNorm())
+    post.setGenes(norm.size());
+  if (dict != nullptr)
+    post.setBits(dict->ids(fname), dict->size());
+  cview = ArrayView<CVdimInfo>();
+  mf.reset();
+};
+
+// the norms of the genes with items dropped, from their kept items in the
+// order of blocks as the CVdimInfo. The norm of a gene without item left is
+// zero
+void CVArray::capNorm(const vector<Kitem> &drop) {
+  vector<char> cut(norm.size(), 0);
+  for (auto &it : drop)
+    cut[it.index] = 1;
+  vector<double> sum(norm.size(), 0);
+  for (size_t t = 0; t < post.index.size(); ++t) {
+    int i = post.index[t];
+    if (cut[i]) {
+      float v = post.value[t];
+      sum[i] += lp == L0 ? 1.0 : lp == L1 ? v : v * v;
+    }
+  }
+  for (size_t i = 0; i < norm.size(); ++i) {
+    if (cut[i])
+      norm[i] = lp == L2 ? sqrt(sum[i]) : sum[i];
+  }
+};
+
+// the L1 norms of signed values, as Hao's, may be negative
+bool CVArray::signedNorm() const {
+  return any_of(norm.begin(), norm.end(), [](float x) { return x < 0; });
+};
+
+// the memory of the CVA used for the similarity
+size_t CVArray::bytes() const {
+  return post.kstr.size() * sizeof(Kstr) +
+         post.offset.size() * sizeof(uint32_t) +
+         post.index.size() * sizeof(int) + post.value.size() * sizeof(float) +
+         post.bits.size() * sizeof(uint64_t) +
+         post.rank.size() * sizeof(uint32_t) +
+         post.goffset.size() * sizeof(uint32_t) +
+         post.gblock.size() * sizeof(uint32_t) +
+         post.gvalue.size() * sizeof(float) +
+         post.dkstr.size() * sizeof(Kstr) +
+         post.dsize.size() * sizeof(uint32_t) +
+         cvdi.size() * sizeof(CVdimInfo) + norm.size() * sizeof(float);
+};
+
+// the union of the sorted kstr lists of genomes by rounds of pairwise
+// merges, the merges in a round are in parallel
+void KDict::unite(vector<vector<Kstr>> &lists) {
+  for (size_t step = 1; step < lists.size(); step *= 2) {
+#pragma omp parallel for schedule(dynamic)
+    for (size_t i = 0; i < lists.size() - step; i += 2 * step) {
+      vector<Kstr> ms;
+      ms.reserve(lists[i].size() + lists[i + step].size());
+      set_union(lists[i].begin(), lists[i].end(), lists[i + step].begin(),
+                lists[i + step].end(), back_inserter(ms));
+      lists[i].swap(ms);
+      vector<Kstr>().swap(lists[i + step]);
+    }
+  }
+  lists.resize(min(lists.size(), size_t(1)));
+};
+
+/** the bitmap of the kstrs kept in the postings by their ids, which are of
+ * the kstrs in the CVA, i.e. the kept and the dropped ones in order. The
+ * bitmap is not kept if the kstrs are too sparse in the dictionary, where the
+ * scan of its words is longer than the merge of kstr lists, or the ids are
+ * not of the CVA */
+void Postings::setBits(const ArrayView<uint32_t> &ids, size_t nkstr) {
+  bits.clear();
+  rank.clear();
+  size_t nword = (nkstr + 63) / 64;
+  if (ids.size() != kstr.size() + dkstr.size() || kstr.size() < nword)
+    return;
+  bits.assign(nword, 0);
+  rank.resize(nword);
+  size_t p(0), q(0);
+  for (size_t i = 0; i < ids.size() && p < kstr.size(); ++i) {
+    if (q < dkstr.size() && dkstr[q] < kstr[p]) {
+      ++q;
+      continue;
+    }
+    bits[ids[i] >> 6] |= 1UL << (ids[i] & 63);
+    ++p;
+  }
+  uint32_t r(0);
+  for (size_t w = 0; w < bits.size(); ++w) {
+    rank[w] = r;
+    r += __builtin_popcountl(bits[w]);
+  }
+};
+
+void Postings::setGenes(size_t ngene) {
+  goffset.assign(ngene + 1, 0);
+  for (auto i : index)
+    ++goffset[i + 1];
+  for (size_t i = 0; i < ngene; ++i)
+    goffset[i + 1] += goffset[i];
+
+  vector<uint32_t> pos(goffset.begin(), goffset.end() - 1);
+  gblock.resize(index.size());
+  gvalue.resize(index.size());
+  for (size_t b = 0; b + 1 < offset.size(); ++b) {
+    for (size_t t = offset[b]; t < offset[b + 1]; ++t) {
+      uint32_t p = pos[index[t]]++;
+      gblock[p] = b;
+      gvalue[p] = value[t];
+    }
+  }
+};
+
+// the shared kstrs of two postings by the AND of their bitmaps, the index of
+// a kstr in a postings is its rank in the bitmap
+void alignByBits(const Postings &pa, const Postings &pb,
+                 vector<pair<size_t, size_t>> &aln) {
+  for (size_t w = 0; w < pa.bits.size(); ++w) {
+    uint64_t m = pa.bits[w] & pb.bits[w];
+    while (m) {
+      uint64_t low = (m & -m) - 1;
+      aln.emplace_back(pa.rank[w] + __builtin_popcountl(pa.bits[w] & low),
+                       pb.rank[w] + __builtin_popcountl(pb.bits[w] & low));
+      m &= m - 1;
+    }
+  }
+};
+
+// view the arrays in the vectors of the postings
+void Postings::view() {
+  kstr = kbuf;
+  offset = obuf;
+  index = ibuf;
+  value = vbuf;
+  mf.reset();
+};
+
+// copy the arrays viewed in the mapped file into the vectors
+void Postings::own() {
+  if (!mf)
+    return;
+  kbuf.assign(kstr.begin(), kstr.end());
+  obuf.assign(offset.begin(), offset.end());
+  ibuf.assign(index.begin(), index.end());
+  vbuf.assign(value.begin(), value.end());
+  view();
+};
+
+void Postings::set(const ArrayView<KdimInfo> &kds,
+                   const ArrayView<Kitem> &its) {
+  if (its.size() > numeric_limits<uint32_t>::max()) {
+    cerr << "Too many items for the postings: " << its.size() << endl;
+    exit(1);
+  }
+  kbuf.resize(kds.size());
+  obuf.resize(kds.size() + 1);
+  for (size_t i = 0; i < kds.size(); ++i) {
+    kbuf[i] = kds[i].kstr;
+    obuf[i] = kds[i].index.first;
+  }
+  obuf.back() = its.size();
+  ibuf.resize(its.size());
+  vbuf.resize(its.size());
+  for (size_t i = 0; i < its.size(); ++i) {
+    ibuf[i] = its[i].index;
+    vbuf[i] = its[i].value;
+  }
+  view();
+};
+
+// the postings of the items sorted by their kstrs
+void Postings::set(const vector<mlong> &kstrs, const vector<Kitem> &its) {
+  if (its.size() > numeric_limits<uint32_t>::max()) {
+    cerr << "Too many items for the postings: " << its.size() << endl;
+    exit(1);
+  }
+  size_t nkstr(0);
+  for (size_t i = 0; i < kstrs.size(); ++i)
+    if (i == 0 || kstrs[i] != kstrs[i - 1])
+      ++nkstr;
+  kbuf.reserve(nkstr);
+  obuf.reserve(nkstr + 1);
+  for (size_t i = 0; i < kstrs.size(); ++i) {
+    if (i == 0 || kstrs[i] != kstrs[i - 1]) {
+      kbuf.emplace_back(kstrs[i]);
+      obuf.emplace_back(i);
+    }
+  }
+  obuf.emplace_back(its.size());
+  ibuf.resize(its.size());
+  vbuf.resize(its.size());
+  for (size_t i = 0; i < its.size(); ++i) {
+    ibuf[i] = its[i].index;
+    vbuf[i] = its[i].value;
+  }
+  view();
+};
+
+// drop the kstrs in more than maxdf genes, their items are given for the
+// norms. The order of kstrs and of items are kept, and the postings viewed
+// in the mapped file are copied to be capped in place
+void Postings::cap(size_t maxdf, vector<Kitem> &drop) {
+  own();
+  size_t nk(0), ni(0);
+  for (size_t i = 0; i < kbuf.size(); ++i) {
+    size_t b = obuf[i];
+    size_t e = obuf[i + 1];
+    if (e - b > maxdf) {
+      dkstr.emplace_back(kbuf[i]);
+      dsize.emplace_back(e - b);
+      for (size_t t = b; t < e; ++t)
+        drop.emplace_back(ibuf[t], vbuf[t]);
+      continue;
+    }
+    kbuf[nk] = kbuf[i];
+    obuf[nk++] = ni;
+    for (size_t t = b; t < e; ++t, ++ni) {
+      ibuf[ni] = ibuf[t];
+      vbuf[ni] = vbuf[t];
+    }
+  }
+  kbuf.resize(nk);
+  obuf.resize(nk + 1);
+  obuf.back() = ni;
+  ibuf.resize(ni);
+  vbuf.resize(ni);
+  view();
+};
+
+// the number of genes with the kstr, kept or dropped
+size_t Postings::df(const Kstr &ks) const {
+  auto it = lower_bound(kstr.begin(), kstr.end(), ks);
+  if (it != kstr.end() && *it == ks) {
+    size_t i = it - kstr.begin();
+    return offset[i + 1] - offset[i];
+  }
+  auto jt = lower_bound(dkstr.begin(), dkstr.end(), ks);
+  if (jt != dkstr.end() && *jt == ks)
+    return dsize[jt - dkstr.begin()];
+  return 0;
 };
 
 void CVArray::read(const string &fname) {
+  // map the uncompressed file
+  string base = cvabase(fname);
+  if (map(base))
+    return;
+
   try {
     // open file to read
     gzFile fp;
-    string gzfile = addsuffix(fname, ".gz");
+    string gzfile = base + ".gz";
     if ((fp = gzopen(gzfile.c_str(), "rb")) == NULL)
       throw runtime_error("Cannot open file for reading: " + gzfile);
 
@@ -98,15 +416,16 @@ void CVArray::read(const string &fname) {
     gzread(fp, (char *)cvdi.data(), sizeof(CVdimInfo) * hd.nCV);
 
     // read the kdiminfo
-    kdi.resize(hd.nKstr);
+    vector<KdimInfo> kdi(hd.nKstr);
     gzread(fp, (char *)kdi.data(), sizeof(KdimInfo) * hd.nKstr);
 
     // read the data
-    data.resize(hd.nItem);
+    vector<Kitem> data(hd.nItem);
     gzread(fp, (char *)data.data(), sizeof(Kitem) * hd.nItem);
 
     // close file
     gzclose(fp);
+    post.set(kdi, data);
 
   } catch (std::exception &e) {
     cerr << "Error reading file: " << fname << "\n" << e.what() << endl;
@@ -117,49 +436,1013 @@ void CVArray::read(const string &fname) {
   }
 };
 
-void CVArray::write(const string &fname) const {
+// map the uncompressed file without copying, its cvdiminfo and the columns
+// of the version 4 file are viewed as the postings in the mapped file, whose
+// pages are shared by all CVArray of the same file. The arrays of the
+// version 2 file are set into the postings
+bool CVArray::map(const string &fname) {
+  auto m = make_shared<MMapFile>();
+  if (!m->open(fname) || m->size < sizeof(CVAHeader))
+    return false;
+  const CVAHeader &hd = *(const CVAHeader *)m->data;
+  if (!hd.valid(m->size))
+    return false;
+
+  // the packed file is decoded into vectors
+  if (hd.version == 3)
+    return unpack(m->data);
+
+  if (hd.version == 2) {
+    post.set(
+        ArrayView<KdimInfo>((const KdimInfo *)(m->data + hd.offKdim), hd.nKstr),
+        ArrayView<Kitem>((const Kitem *)(m->data + hd.offData), hd.nItem));
+  } else {
+    // the blocks of kstrs are in order and cover all items
+    const CVAPack &pk = *(const CVAPack *)(m->data + sizeof(CVAHeader));
+    const uint32_t *off = (const uint32_t *)(m->data + pk.offSize);
+    if (off[0] != 0 || off[hd.nKstr] != hd.nItem)
+      return false;
+    for (size_t i = 0; i < hd.nKstr; ++i)
+      if (off[i] > off[i + 1])
+        return false;
+    const Kstr *ks = (const Kstr *)(m->data + hd.offKdim);
+    const int *ndx = (const int *)(m->data + hd.offData);
+    const float *val = (const float *)(m->data + pk.offValue);
+    post.kstr = ArrayView<Kstr>(ks, hd.nKstr);
+    post.offset = ArrayView<uint32_t>(off, hd.nKstr + 1);
+    post.index = ArrayView<int>(ndx, hd.nItem);
+    post.value = ArrayView<float>(val, hd.nItem);
+    post.mf = m;
+  }
+  cview = ArrayView<CVdimInfo>((const CVdimInfo *)(m->data + hd.offCV), hd.nCV);
+  mf = m;
+  return true;
+};
+
+// pad the file with zeros up to the offset
+void padTo(FILE *fp, size_t off) {
+  static const char zeros[64] = {0};
+  size_t pos = ftell(fp);
+  if (pos < off)
+    fwrite(zeros, 1, off - pos, fp);
+};
+
+// write the items into the file, the short write as on a full disk is fatal
+void writeTo(FILE *fp, const void *p, size_t size, size_t n,
+             const string &fname) {
+  if (n > 0 && fwrite(p, size, n, fp) != n) {
+    cerr << "Error happen on write file: " << fname << endl;
+    exit(1);
+  }
+};
+
+// close the written file, the error on flushing is fatal
+void closeTo(FILE *fp, const string &fname) {
+  if (ferror(fp) || fclose(fp) != 0) {
+    cerr << "Error happen on write file: " << fname << endl;
+    exit(1);
+  }
+};
+
+// move the complete temporary file to its name
+void CVArray::write(const string &fname, enum CVAFormat fmt) const {
+  auto cds = cvdims();
+
+  // remove the file of the other format, which may be out of date
+  string base = cvabase(fname);
+  string file = fmt == LEGACY ? base + ".gz" : base;
+  remove((fmt == LEGACY ? base : base + ".gz").c_str());
+
+  // the file is written in a temporary one, and renamed when complete
+  string tfile = tmpName(file);
+  if (fmt == PACKED) {
+    FILE *fp;
+    if ((fp = fopen(tfile.c_str(), "wb")) == NULL) {
+      cerr << "Error happen on write cvfile: " << file << endl;
+      exit(1);
+    }
+    CVAColumns cols;
+    cols.encode(post);
+    if (cols.exact) {
+      cols.write(fp, cds);
+    } else {
+      vector<CVdimInfo> qcds(cds.begin(), cds.end());
+      cols.setNorms(post, qcds);
+      cols.write(fp, qcds);
+    }
+    closeTo(fp, file);
+    renameTo(tfile, file);
+    return;
+  }
+
+  if (fmt == V2) {
+    FILE *fp;
+    if ((fp = fopen(tfile.c_str(), "wb")) == NULL) {
+      cerr << "Error happen on write cvfile: " << file << endl;
+      exit(1);
+    }
+    CVAPack pk;
+    CVAHeader hd(cds.size(), post.kstr.size(), post.index.size(), pk);
+    writeTo(fp, &hd, sizeof(CVAHeader), 1, file);
+    writeTo(fp, &pk, sizeof(CVAPack), 1, file);
+    padTo(fp, hd.offCV);
+    writeTo(fp, cds.begin(), sizeof(CVdimInfo), cds.size(), file);
+    padTo(fp, hd.offKdim);
+    writeTo(fp, post.kstr.begin(), sizeof(Kstr), post.kstr.size(), file);
+    padTo(fp, pk.offSize);
+    writeTo(fp, post.offset.begin(), sizeof(uint32_t), post.offset.size(),
+            file);
+    padTo(fp, hd.offData);
+    writeTo(fp, post.index.begin(), sizeof(int), post.index.size(), file);
+    padTo(fp, pk.offValue);
+    writeTo(fp, post.value.begin(), sizeof(float), post.value.size(), file);
+    closeTo(fp, file);
+    renameTo(tfile, file);
+    return;
+  }
+
   // open and test file
   gzFile fp;
-  string gzfile = addsuffix(fname, ".gz");
-  if ((fp = gzopen(gzfile.c_str(), "wb")) == NULL) {
-    cerr << "Error happen on write cvfile: " << gzfile << endl;
+  if ((fp = gzopen(tfile.c_str(), "wb")) == NULL) {
+    cerr << "Error happen on write cvfile: " << file << endl;
     exit(1);
   }
 
-  // write the size of CVArray
-  CVAinfo hd(cvdi.size(), kdi.size(), data.size());
-  gzwrite(fp, &hd, sizeof(CVAinfo));
+  // write the size of CVArray and the diminfo
+  size_t nkstr = post.kstr.size(), nitem = post.index.size();
+  CVAinfo hd(cds.size(), nkstr, nitem);
+  bool ok = gzwrite(fp, &hd, sizeof(CVAinfo)) > 0;
+  if (!cds.empty())
+    ok = ok && gzwrite(fp, cds.begin(), cds.size() * sizeof(CVdimInfo)) > 0;
 
-  // write the diminfo and data
-  gzwrite(fp, cvdi.data(), cvdi.size() * sizeof(CVdimInfo));
-  gzwrite(fp, kdi.data(), kdi.size() * sizeof(KdimInfo));
-  gzwrite(fp, data.data(), data.size() * sizeof(Kitem));
+  // write the kdiminfo and data by chunks from the postings
+  const size_t nchunk = 1 << 16;
+  vector<KdimInfo> kbuf;
+  for (size_t i = 0; ok && i < nkstr; ++i) {
+    kbuf.emplace_back(post.kstr[i], post.offset[i], post.offset[i + 1]);
+    if (kbuf.size() == nchunk || i + 1 == nkstr) {
+      ok = gzwrite(fp, kbuf.data(), kbuf.size() * sizeof(KdimInfo)) > 0;
+      kbuf.clear();
+    }
+  }
+  vector<Kitem> dbuf;
+  for (size_t i = 0; ok && i < nitem; ++i) {
+    dbuf.emplace_back(post.index[i], post.value[i]);
+    if (dbuf.size() == nchunk || i + 1 == nitem) {
+      ok = gzwrite(fp, dbuf.data(), dbuf.size() * sizeof(Kitem)) > 0;
+      dbuf.clear();
+    }
+  }
 
   // close file
-  gzclose(fp);
+  if (gzclose(fp) != Z_OK || !ok) {
+    cerr << "Error happen on write cvfile: " << file << endl;
+    exit(1);
+  }
+  renameTo(tfile, file);
+};
+
+// the CVs of genes from the inverted array, sorted by kstr
+void CVArray::getcvs(vector<CVvec> &cvs) const {
+  cvs.resize(cvdims().size());
+  for (size_t i = 0; i < post.kstr.size(); ++i) {
+    for (auto t = post.offset[i]; t < post.offset[i + 1]; ++t)
+      cvs[post.index[t]].emplace_back(post.kstr[i], post.value[t]);
+  }
 };
 
 ostream &operator<<(ostream &os, const CVArray &cva) {
+  auto cds = cva.cvdims();
+  const Postings &post = cva.post;
+
   // output cvdiminfo
-  os << "The number of CV is " << cva.cvdi.size() << "\nThe number of K is "
-     << cva.kdi.size() << "\nThe number of items is " << cva.data.size()
+  os << "The number of CV is " << cds.size() << "\nThe number of K is "
+     << post.kstr.size() << "\nThe number of items is " << post.index.size()
      << endl;
 
   os << "\n==== The Norms ========================\n";
-  for (const auto &cd : cva.cvdi) {
+  for (const auto &cd : cds) {
     os << cd << "\n";
   }
   os << endl;
 
-  // output data according to kdiminfo
+  // output data according to the blocks of kstrs
   os << "\n==== The kmer items ====================\n";
-  for (const auto &kd : cva.kdi) {
-    os << kd.kstr << "\t";
-    for (auto i = kd.index.first; i < kd.index.second; ++i) {
-      os << cva.data[i] << " ";
+  for (size_t i = 0; i < post.kstr.size(); ++i) {
+    os << post.kstr[i] << "\t";
+    for (auto t = post.offset[i]; t < post.offset[i + 1]; ++t) {
+      os << Kitem(post.index[t], post.value[t]) << " ";
     }
     os << endl;
   }
 
   return os;
 };
+
+/*************************************************************
+ * The uncompressed file of CVA
+ *************************************************************/
+// the offset aligned by 64 bytes
+inline size_t alignup(size_t n) { return (n + 63) / 64 * 64; };
+
+// the version 4 file by the columns of postings: kstrs, the CSR offsets of
+// their blocks, and the gene indices and the values of items
+CVAHeader::CVAHeader(size_t nc, size_t nk, size_t ni, CVAPack &pk)
+    : nCV(nc), nKstr(nk), nItem(ni) {
+  if (nItem > numeric_limits<uint32_t>::max()) {
+    cerr << "Too many items for the CVA file: " << nItem << endl;
+    exit(1);
+  }
+  offCV = alignup(sizeof(CVAHeader) + sizeof(CVAPack));
+  offKdim = alignup(offCV + nCV * sizeof(CVdimInfo));
+  pk.offSize = alignup(offKdim + nKstr * sizeof(Kstr));
+  offData = alignup(pk.offSize + (nKstr + 1) * sizeof(uint32_t));
+  pk.offValue = alignup(offData + nItem * sizeof(int));
+  pk.vbits = 32;
+  pk.scale = 1.0;
+  pk.exact = 1;
+};
+
+// the sections are in order and within the file, and every kstr or item
+// takes one byte at least in the packed columns
+bool CVAHeader::valid(size_t fsize) const {
+  if (memcmp(magic, CVAHeader().magic, sizeof(magic)) != 0)
+    return false;
+  if (version == 2)
+    return sizeof(CVAHeader) <= offCV && offCV <= offKdim &&
+           offKdim <= offData && offData <= fsize &&
+           nCV <= (offKdim - offCV) / sizeof(CVdimInfo) &&
+           nKstr <= (offData - offKdim) / sizeof(KdimInfo) &&
+           nItem <= (fsize - offData) / sizeof(Kitem);
+  if (version == 3 && fsize >= sizeof(CVAHeader) + sizeof(CVAPack)) {
+    const CVAPack &pk = *(const CVAPack *)(this + 1);
+    return (pk.vbits == 8 || pk.vbits == 16) &&
+           sizeof(CVAHeader) + sizeof(CVAPack) <= offCV && offCV <= offKdim &&
+           offKdim <= pk.offSize && pk.offSize <= offData &&
+           offData <= pk.offValue && pk.offValue <= fsize &&
+           nCV <= (offKdim - offCV) / sizeof(CVdimInfo) &&
+           nKstr <= pk.offSize - offKdim && nKstr <= offData - pk.offSize &&
+           nItem <= pk.offValue - offData &&
+           nItem <= (fsize - pk.offValue) / (pk.vbits / 8);
+  }
+  if (version == 4 && fsize >= sizeof(CVAHeader) + sizeof(CVAPack)) {
+    const CVAPack &pk = *(const CVAPack *)(this + 1);
+    return pk.vbits == 32 && sizeof(CVAHeader) + sizeof(CVAPack) <= offCV &&
+           offCV <= offKdim && offKdim <= pk.offSize &&
+           pk.offSize <= offData && offData <= pk.offValue &&
+           pk.offValue <= fsize &&
+           nCV <= (offKdim - offCV) / sizeof(CVdimInfo) &&
+           nKstr <= (pk.offSize - offKdim) / sizeof(Kstr) &&
+           nKstr < (offData - pk.offSize) / sizeof(uint32_t) &&
+           nItem <= (pk.offValue - offData) / sizeof(int) &&
+           nItem <= (fsize - pk.offValue) / sizeof(float);
+  }
+  return false;
+};
+
+/*************************************************************
+ * The packed columns of CVA in the version 3 file
+ *************************************************************/
+inline void putVarint(vector<uint8_t> &buf, uint64_t v) {
+  while (v >= 0x80) {
+    buf.emplace_back(uint8_t(v) | 0x80);
+    v >>= 7;
+  }
+  buf.emplace_back(uint8_t(v));
+};
+
+// the varint is read within its section, and fails at the end of section
+inline bool getVarint(const uint8_t *&p, const uint8_t *end, uint64_t &v) {
+  v = 0;
+  for (int sh = 0; p < end && sh < 64; sh += 7) {
+    uint8_t b = *p++;
+    v |= uint64_t(b & 0x7F) << sh;
+    if (b < 0x80)
+      return true;
+  }
+  return false;
+};
+
+void CVAColumns::encode(const Postings &post) {
+  // the kstrs, the sizes of blocks and the indices in blocks
+  nkstr = post.kstr.size();
+  nitem = post.index.size();
+  mlong ks(0);
+  for (size_t b = 0; b < nkstr; ++b) {
+    putVarint(kstr, post.kstr[b].ks - ks);
+    ks = post.kstr[b].ks;
+    putVarint(size, post.offset[b + 1] - post.offset[b]);
+    int ndx(0);
+    for (auto i = post.offset[b]; i < post.offset[b + 1]; ++i) {
+      putVarint(index, post.index[i] - ndx);
+      ndx = post.index[i];
+    }
+  }
+
+  // the values are kept exactly by 8 or 16 bits if they are small integers,
+  // otherwise they are quantized by 16 bits with the scale of maximal value
+  const auto &vals = post.value;
+  float vmax(0);
+  bool integral(true);
+  for (auto v : vals) {
+    vmax = max(vmax, fabs(v));
+    integral = integral && v == nearbyint(v);
+  }
+  pack.scale = 1.0;
+  pack.vbits = 16;
+  if (integral && vmax <= 127)
+    pack.vbits = 8;
+  else if (!integral || vmax > 32767)
+    pack.scale = vmax > 0 ? vmax / 32767 : 1.0;
+
+  value.resize(vals.size() * pack.vbits / 8);
+  float rs = 1.0 / pack.scale;
+  if (pack.vbits == 8) {
+    int8_t *q = (int8_t *)value.data();
+    for (size_t i = 0; i < vals.size(); ++i)
+      q[i] = int8_t(lrint(vals[i]));
+  } else {
+    int16_t *q = (int16_t *)value.data();
+    for (size_t i = 0; i < vals.size(); ++i)
+      q[i] = int16_t(lrint(vals[i] * rs));
+  }
+  exact = integral && vmax <= 32767;
+  pack.exact = exact;
+};
+
+// the value of an item as it is read from the file
+float CVAColumns::decode(size_t i) const {
+  if (pack.vbits == 8)
+    return ((const int8_t *)value.data())[i] * pack.scale;
+  return ((const int16_t *)value.data())[i] * pack.scale;
+};
+
+// the norms of genes by the quantized values, so that they agree with the
+// values read from the file. The items of a gene are summed in the order of
+// kstr as the CVdimInfo of a CV
+void CVAColumns::setNorms(const Postings &post,
+                          vector<CVdimInfo> &cds) const {
+  for (auto &cd : cds)
+    cd.lasso = cd.norm = 0.0;
+  for (size_t i = 0; i < post.index.size(); ++i) {
+    double v = decode(i);
+    auto &cd = cds[post.index[i]];
+    cd.lasso += v;
+    cd.norm += v * v;
+  }
+  for (auto &cd : cds)
+    cd.norm = sqrt(cd.norm);
+};
+
+void CVAColumns::write(FILE *fp, const ArrayView<CVdimInfo> &cds) const {
+  CVAHeader hd;
+  hd.version = 3;
+  hd.nCV = cds.size();
+  hd.nKstr = nkstr;
+  hd.nItem = nitem;
+  CVAPack pk = pack;
+  hd.offCV = alignup(sizeof(CVAHeader) + sizeof(CVAPack));
+  hd.offKdim = alignup(hd.offCV + cds.size() * sizeof(CVdimInfo));
+  pk.offSize = alignup(hd.offKdim + kstr.size());
+  hd.offData = alignup(pk.offSize + size.size());
+  pk.offValue = alignup(hd.offData + index.size());
+
+  fwrite(&hd, sizeof(CVAHeader), 1, fp);
+  fwrite(&pk, sizeof(CVAPack), 1, fp);
+  padTo(fp, hd.offCV);
+  fwrite(cds.begin(), sizeof(CVdimInfo), cds.size(), fp);
+  padTo(fp, hd.offKdim);
+  fwrite(kstr.data(), 1, kstr.size(), fp);
+  padTo(fp, pk.offSize);
+  fwrite(size.data(), 1, size.size(), fp);
+  padTo(fp, hd.offData);
+  fwrite(index.data(), 1, index.size(), fp);
+  padTo(fp, pk.offValue);
+  fwrite(value.data(), 1, value.size(), fp);
+};
+
+bool CVArray::unpack(const char *p) {
+  const CVAHeader &hd = *(const CVAHeader *)p;
+  const CVAPack &pk = *(const CVAPack *)(p + sizeof(CVAHeader));
+  const CVdimInfo *cd = (const CVdimInfo *)(p + hd.offCV);
+  cvdi.assign(cd, cd + hd.nCV);
+
+  // the kstrs and the indices of items, each column ends at the next one
+  if (hd.nItem > numeric_limits<uint32_t>::max())
+    return false;
+  auto &kbuf = post.kbuf;
+  auto &obuf = post.obuf;
+  auto &ibuf = post.ibuf;
+  auto &vbuf = post.vbuf;
+  kbuf.resize(hd.nKstr);
+  obuf.resize(hd.nKstr + 1);
+  ibuf.resize(hd.nItem);
+  vbuf.resize(hd.nItem);
+  const uint8_t *pk0 = (const uint8_t *)(p + hd.offKdim);
+  const uint8_t *ps = (const uint8_t *)(p + pk.offSize);
+  const uint8_t *pi = (const uint8_t *)(p + hd.offData);
+  const uint8_t *ek = ps, *es = pi, *ei = (const uint8_t *)(p + pk.offValue);
+  mlong ks(0);
+  size_t pos(0);
+  uint64_t dk, n, di;
+  for (size_t b = 0; b < hd.nKstr; ++b) {
+    if (!getVarint(pk0, ek, dk) || !getVarint(ps, es, n) ||
+        n > hd.nItem - pos)
+      return false;
+    ks += dk;
+    kbuf[b] = Kstr(ks);
+    obuf[b] = pos;
+    int ndx(0);
+    for (size_t i = pos; i < pos + n; ++i) {
+      if (!getVarint(pi, ei, di))
+        return false;
+      ndx += di;
+      ibuf[i] = ndx;
+    }
+    pos += n;
+  }
+  if (pos != hd.nItem)
+    return false;
+  obuf.back() = pos;
+
+  // the values
+  float sc = pk.scale;
+  if (pk.vbits == 8) {
+    const int8_t *q = (const int8_t *)(p + pk.offValue);
+    for (size_t i = 0; i < hd.nItem; ++i)
+      vbuf[i] = q[i] * sc;
+  } else {
+    const int16_t *q = (const int16_t *)(p + pk.offValue);
+    for (size_t i = 0; i < hd.nItem; ++i)
+      vbuf[i] = q[i] * sc;
+  }
+  post.view();
+  return true;
+};
+
+string cvabase(const string &fname) {
+  string sfx = ".gz";
+  if (fname.size() > sfx.size() &&
+      fname.compare(fname.size() - sfx.size(), sfx.size(), sfx) == 0)
+    return fname.substr(0, fname.size() - sfx.size());
+  return fname;
+};
+
+bool cvavalid(const string &fname) {
+  string base = cvabase(fname);
+  MMapFile mf;
+  if (mf.open(base) && mf.size >= sizeof(CVAHeader) &&
+      ((const CVAHeader *)mf.data)->valid(mf.size))
+    return true;
+  return gzvalid(base);
+};
+
+bool cvaexact(const string &fname) {
+  MMapFile mf;
+  if (!mf.open(cvabase(fname)) ||
+      mf.size < sizeof(CVAHeader) + sizeof(CVAPack) ||
+      ((const CVAHeader *)mf.data)->version != 3)
+    return true;
+  return ((const CVAPack *)(mf.data + sizeof(CVAHeader)))->exact != 0;
+};
+
+// the kstrs of the CVA file from its column of kstrs without the items, the
+// legacy file is read up to its kdiminfo
+void readKstrs(const string &fname, vector<Kstr> &ks) {
+  ks.clear();
+  string base = cvabase(fname);
+  MMapFile mf;
+  if (mf.open(base) && mf.size >= sizeof(CVAHeader) &&
+      ((const CVAHeader *)mf.data)->valid(mf.size)) {
+    const CVAHeader &hd = *(const CVAHeader *)mf.data;
+    ks.reserve(hd.nKstr);
+    if (hd.version == 2) {
+      const KdimInfo *kd = (const KdimInfo *)(mf.data + hd.offKdim);
+      for (size_t i = 0; i < hd.nKstr; ++i)
+        ks.emplace_back(kd[i].kstr);
+      return;
+    }
+    if (hd.version == 4) {
+      const Kstr *kp = (const Kstr *)(mf.data + hd.offKdim);
+      ks.assign(kp, kp + hd.nKstr);
+      return;
+    }
+    const CVAPack &pk = *(const CVAPack *)(mf.data + sizeof(CVAHeader));
+    const uint8_t *p = (const uint8_t *)(mf.data + hd.offKdim);
+    const uint8_t *pe = (const uint8_t *)(mf.data + pk.offSize);
+    mlong k(0);
+    uint64_t dk;
+    for (size_t i = 0; i < hd.nKstr; ++i) {
+      if (!getVarint(p, pe, dk)) {
+        cerr << "Error reading file: " << base << endl;
+        exit(1);
+      }
+      k += dk;
+      ks.emplace_back(Kstr(k));
+    }
+    return;
+  }
+
+  gzFile fp;
+  string gzfile = base + ".gz";
+  if ((fp = gzopen(gzfile.c_str(), "rb")) == NULL) {
+    cerr << "Cannot open file for reading: " << gzfile << endl;
+    exit(1);
+  }
+  CVAinfo hd;
+  bool ok = gzread(fp, (char *)&hd, sizeof(CVAinfo)) == int(sizeof(CVAinfo)) &&
+            gzseek(fp, hd.nCV * sizeof(CVdimInfo), SEEK_CUR) >= 0;
+  vector<KdimInfo> kdi(1 << 16);
+  ks.reserve(ok ? hd.nKstr : 0);
+  for (size_t i = 0; ok && i < hd.nKstr; i += kdi.size()) {
+    size_t n = min(kdi.size(), hd.nKstr - i);
+    ok = gzread(fp, (char *)kdi.data(), n * sizeof(KdimInfo)) ==
+         int(n * sizeof(KdimInfo));
+    for (size_t j = 0; ok && j < n; ++j)
+      ks.emplace_back(kdi[j].kstr);
+  }
+  gzclose(fp);
+  if (!ok) {
+    cerr << "Error reading file: " << gzfile << endl;
+    exit(1);
+  }
+};
+
+/*************************************************************
+ * Build the CVA file by the sorted runs within memory budget
+ *************************************************************/
+RunReader::RunReader(const string &fn, size_t n) : fname(fn), chunk(n) {
+  if ((fp = fopen(fname.c_str(), "rb")) == NULL) {
+    cerr << "Error happen on read run file: " << fname << endl;
+    exit(1);
+  }
+  fill();
+};
+
+RunReader::~RunReader() {
+  if (fp != nullptr)
+    fclose(fp);
+};
+
+void RunReader::next() {
+  if (++pos >= chunk.size())
+    fill();
+};
+
+void RunReader::fill() {
+  chunk.resize(chunk.capacity());
+  chunk.resize(fread(chunk.data(), sizeof(Kpost), chunk.size(), fp));
+  if (ferror(fp)) {
+    cerr << "Error happen on read run file: " << fname << endl;
+    exit(1);
+  }
+  pos = 0;
+};
+
+// the budget in MB holds the buffer and the sorting buffer of items
+CVAStream::CVAStream(const string &fn, size_t mb, enum CVAFormat f)
+    : fname(fn), fmt(f) {
+  nbuf = max(size_t(1) << 12, (mb << 20) / (2 * sizeof(Kpost)));
+};
+
+void CVAStream::add(const CVvec &cv) {
+  int ndx = cvdi.size();
+  cvdi.emplace_back(CVdimInfo(cv));
+  for (const auto &cd : cv) {
+    buf.emplace_back(cd.first.ks, Kitem(ndx, cd.second));
+    if (buf.size() >= nbuf)
+      spill();
+  }
+};
+
+// the stable sort by kstr keeps the order of CV in every kstr
+void CVAStream::sortbuf() {
+  mlong kmax(0);
+  for (const auto &it : buf)
+    kmax = max(kmax, it.first);
+  radixSort(buf, sbuf, nbitOf(kmax), [](const Kpost &a) { return a.first; });
+};
+
+void CVAStream::spill() {
+  sortbuf();
+  string rfile = fname + ".run" + to_string(nrun++);
+  FILE *fp;
+  if ((fp = fopen(rfile.c_str(), "wb")) == NULL) {
+    cerr << "Error happen on write run file: " << rfile << endl;
+    exit(1);
+  }
+  writeTo(fp, buf.data(), sizeof(Kpost), buf.size(), rfile);
+  closeTo(fp, rfile);
+  runs.emplace_back(rfile);
+  buf.clear();
+};
+
+size_t CVAStream::close() {
+  if (runs.empty()) {
+    // all items in memory
+    sortbuf();
+    if (buf.size() > numeric_limits<uint32_t>::max()) {
+      cerr << "Too many items for the postings: " << buf.size() << endl;
+      exit(1);
+    }
+    CVArray cva;
+    cva.cvdi.swap(cvdi);
+    auto &post = cva.post;
+    post.ibuf.reserve(buf.size());
+    post.vbuf.reserve(buf.size());
+    for (const auto &it : buf) {
+      if (post.kbuf.empty() || post.kbuf.back().ks != it.first) {
+        post.kbuf.emplace_back(it.first);
+        post.obuf.emplace_back(post.ibuf.size());
+      }
+      post.ibuf.emplace_back(it.second.index);
+      post.vbuf.emplace_back(it.second.value);
+    }
+    post.obuf.emplace_back(post.ibuf.size());
+    post.view();
+    vector<Kpost>().swap(buf);
+    vector<Kpost>().swap(sbuf);
+    cva.write(fname, fmt);
+    return cva.cvdi.size();
+  }
+
+  // merge the runs on disk
+  if (!buf.empty())
+    spill();
+  vector<Kpost>().swap(buf);
+  vector<Kpost>().swap(sbuf);
+  while (runs.size() > fanin)
+    mergePass();
+  merge();
+  for (auto &rfile : runs)
+    remove(rfile.c_str());
+  return cvdi.size();
+};
+
+// merge the runs by the heap of their heads, the tie of kstr is broken by the
+// order of runs. The items are passed to emit in order
+// the chunks of a temporary file of the merge are given to emit, and the
+// file is removed
+template <typename F>
+static void copyTemp(const string &fname, vector<char> &buf, F emit) {
+  FILE *fp;
+  if ((fp = fopen(fname.c_str(), "rb")) == NULL) {
+    cerr << "Error happen on read temporary file: " << fname << endl;
+    exit(1);
+  }
+  size_t n;
+  while ((n = fread(buf.data(), 1, buf.size(), fp)) > 0)
+    emit(n);
+  if (ferror(fp)) {
+    cerr << "Error happen on read temporary file: " << fname << endl;
+    exit(1);
+  }
+  fclose(fp);
+  remove(fname.c_str());
+};
+
+template <typename F>
+static void mergeRuns(const vector<string> &rfiles, size_t nchunk, F emit) {
+  vector<unique_ptr<RunReader>> readers;
+  typedef pair<mlong, size_t> Head;
+  priority_queue<Head, vector<Head>, greater<Head>> heads;
+  for (size_t i = 0; i < rfiles.size(); ++i) {
+    readers.emplace_back(new RunReader(rfiles[i], nchunk));
+    if (readers.back()->valid())
+      heads.emplace(readers.back()->item().first, i);
+  }
+  while (!heads.empty()) {
+    size_t i = heads.top().second;
+    heads.pop();
+    emit(readers[i]->item());
+    readers[i]->next();
+    if (readers[i]->valid())
+      heads.emplace(readers[i]->item().first, i);
+  }
+};
+
+// merge every fanin consecutive runs into one, so that the order of runs is
+// kept and no more than fanin files are opened at once
+void CVAStream::mergePass() {
+  size_t nchunk = max(size_t(1) << 10, 2 * nbuf / (fanin + 2));
+  vector<string> merged;
+  vector<Kpost> obuf;
+  obuf.reserve(nchunk);
+  for (size_t i = 0; i < runs.size(); i += fanin) {
+    vector<string> group(runs.begin() + i,
+                         runs.begin() + min(i + fanin, runs.size()));
+    if (group.size() == 1) {
+      merged.emplace_back(group[0]);
+      continue;
+    }
+    string rfile = fname + ".run" + to_string(nrun++);
+    FILE *fp;
+    if ((fp = fopen(rfile.c_str(), "wb")) == NULL) {
+      cerr << "Error happen on write run file: " << rfile << endl;
+      exit(1);
+    }
+    mergeRuns(group, nchunk, [&](const Kpost &it) {
+      obuf.emplace_back(it);
+      if (obuf.size() == nchunk) {
+        writeTo(fp, obuf.data(), sizeof(Kpost), obuf.size(), rfile);
+        obuf.clear();
+      }
+    });
+    writeTo(fp, obuf.data(), sizeof(Kpost), obuf.size(), rfile);
+    obuf.clear();
+    closeTo(fp, rfile);
+    for (auto &f : group)
+      remove(f.c_str());
+    merged.emplace_back(rfile);
+  }
+  runs.swap(merged);
+};
+
+// the temporary file of a column of the merge, written by chunks
+template <typename T> struct TempColumn {
+  string fname;
+  FILE *fp = nullptr;
+  size_t nchunk = 0;
+  vector<T> buf;
+
+  void open(const string &fn, size_t n) {
+    fname = fn;
+    nchunk = n;
+    buf.reserve(nchunk);
+    if ((fp = fopen(fname.c_str(), "wb")) == NULL) {
+      cerr << "Error happen on write temporary file: " << fname << endl;
+      exit(1);
+    }
+  };
+  void add(const T &x) {
+    buf.emplace_back(x);
+    if (buf.size() == nchunk) {
+      writeTo(fp, buf.data(), sizeof(T), buf.size(), fname);
+      buf.clear();
+    }
+  };
+  void close() {
+    writeTo(fp, buf.data(), sizeof(T), buf.size(), fname);
+    closeTo(fp, fname);
+  };
+};
+
+// merge runs into the temporary files of columns, and then join them into
+// CVA. They are the columns of postings for the version 4 file, and the
+// kdiminfo and data for the legacy one. The tie of kstr is broken by the
+// order of runs, i.e. the order of CV.
+void CVAStream::merge() {
+  size_t nchunk = max(size_t(1) << 10, 2 * nbuf / (runs.size() + 2));
+
+  // the output of columns by chunks
+  TempColumn<Kstr> kcol;
+  TempColumn<uint32_t> ocol;
+  TempColumn<int> icol;
+  TempColumn<float> vcol;
+  TempColumn<KdimInfo> kdcol;
+  TempColumn<Kitem> dcol;
+  if (fmt != LEGACY) {
+    kcol.open(fname + ".kstr", nchunk);
+    ocol.open(fname + ".offset", nchunk);
+    icol.open(fname + ".index", nchunk);
+    vcol.open(fname + ".value", nchunk);
+  } else {
+    kdcol.open(fname + ".kdi", nchunk);
+    dcol.open(fname + ".data", nchunk);
+  }
+  size_t nkstr(0), nitem(0);
+  KdimInfo kd;
+  mergeRuns(runs, nchunk, [&](const Kpost &it) {
+    if (nitem == 0 || kd.kstr.ks != it.first) {
+      if (nitem != 0 && fmt == LEGACY)
+        kdcol.add(kd);
+      if (fmt != LEGACY) {
+        kcol.add(Kstr(it.first));
+        ocol.add(nitem);
+      }
+      kd = KdimInfo(Kstr(it.first), nitem, nitem);
+      ++nkstr;
+    }
+    if (fmt != LEGACY) {
+      icol.add(it.second.index);
+      vcol.add(it.second.value);
+    } else {
+      dcol.add(it.second);
+    }
+    ++kd.index.second;
+    ++nitem;
+  });
+
+  // join the CVA file
+  string base = cvabase(fname);
+  remove((fmt == LEGACY ? base : base + ".gz").c_str());
+  vector<char> cbuf(1UL << 20);
+  if (fmt != LEGACY) {
+    ocol.add(nitem);
+    kcol.close();
+    ocol.close();
+    icol.close();
+    vcol.close();
+
+    // the version 4 file to be packed is apart from the temporary one of pack
+    string tfile = tmpName(fmt == PACKED ? base + ".v2" : base);
+    FILE *fp;
+    if ((fp = fopen(tfile.c_str(), "wb")) == NULL) {
+      cerr << "Error happen on write cvfile: " << base << endl;
+      exit(1);
+    }
+    CVAPack pk;
+    CVAHeader hd(cvdi.size(), nkstr, nitem, pk);
+    writeTo(fp, &hd, sizeof(CVAHeader), 1, base);
+    writeTo(fp, &pk, sizeof(CVAPack), 1, base);
+    padTo(fp, hd.offCV);
+    writeTo(fp, cvdi.data(), sizeof(CVdimInfo), cvdi.size(), base);
+    for (auto &tf : {make_pair(kcol.fname, hd.offKdim),
+                     make_pair(ocol.fname, pk.offSize),
+                     make_pair(icol.fname, hd.offData),
+                     make_pair(vcol.fname, pk.offValue)}) {
+      padTo(fp, tf.second);
+      copyTemp(tf.first, cbuf,
+               [&](size_t n) { writeTo(fp, cbuf.data(), 1, n, base); });
+    }
+    closeTo(fp, base);
+
+    // pack the columns from the mapped version 4 file
+    if (fmt == PACKED) {
+      CVArray cva;
+      cva.map(tfile);
+      cva.write(base, PACKED);
+      remove(tfile.c_str());
+    } else {
+      renameTo(tfile, base);
+    }
+    return;
+  }
+
+  if (nitem != 0)
+    kdcol.add(kd);
+  kdcol.close();
+  dcol.close();
+  gzFile fp;
+  string gzfile = base + ".gz";
+  string tfile = tmpName(gzfile);
+  if ((fp = gzopen(tfile.c_str(), "wb")) == NULL) {
+    cerr << "Error happen on write cvfile: " << gzfile << endl;
+    exit(1);
+  }
+  CVAinfo hd(cvdi.size(), nkstr, nitem);
+  bool ok = gzwrite(fp, &hd, sizeof(CVAinfo)) > 0;
+  if (!cvdi.empty())
+    ok = ok && gzwrite(fp, cvdi.data(), cvdi.size() * sizeof(CVdimInfo)) > 0;
+  for (auto &tfile : {kdcol.fname, dcol.fname})
+    copyTemp(tfile, cbuf,
+             [&](size_t n) { ok = ok && gzwrite(fp, cbuf.data(), n) > 0; });
+  if (gzclose(fp) != Z_OK || !ok) {
+    cerr << "Error happen on write cvfile: " << gzfile << endl;
+    exit(1);
+  }
+  renameTo(tfile, gzfile);
+};
+
+/*************************************************************
+ * The dictionary of kstrs in the cache
+ *************************************************************/
+/** build the dictionary of the CVAs and write the ids of their kstrs in the
+ * file. The kstrs of a CVA are read from its column of kstrs. Every thread
+ * merges the lists of its CVAs as a binary counter, so only a few lists are
+ * kept, and the lists of threads are merged at last. The ids of CVAs are got
+ * and written by batches of threads */
+void KDict::build(const string &fname, const vector<string> &cvlist) {
+  int nt = omp_get_max_threads();
+  vector<vector<Kstr>> parts(nt);
+#pragma omp parallel for schedule(static, 1)
+  for (int t = 0; t < nt; ++t) {
+    vector<pair<int, vector<Kstr>>> stack;
+    for (size_t i = t; i < cvlist.size(); i += nt) {
+      stack.emplace_back(0, vector<Kstr>());
+      readKstrs(cvlist[i], stack.back().second);
+      while (stack.size() > 1 &&
+             stack.back().first == stack[stack.size() - 2].first) {
+        vector<vector<Kstr>> two(2);
+        two[0].swap(stack[stack.size() - 2].second);
+        two[1].swap(stack.back().second);
+        unite(two);
+        stack.pop_back();
+        stack.back().first++;
+        stack.back().second.swap(two[0]);
+      }
+    }
+    vector<vector<Kstr>> rest;
+    for (auto &it : stack)
+      rest.emplace_back(move(it.second));
+    unite(rest);
+    if (!rest.empty())
+      parts[t].swap(rest[0]);
+  }
+  unite(parts);
+  vector<Kstr> dict;
+  if (!parts.empty())
+    dict.swap(parts[0]);
+  if (dict.size() > numeric_limits<uint32_t>::max())
+    return;
+
+  // the names of CVAs, and the offsets of their ids by their sizes
+  KDictHeader hd;
+  hd.nkstr = dict.size();
+  hd.ncva = cvlist.size();
+  string names;
+  for (auto &cv : cvlist)
+    names += getFileName(cv) + "\n";
+  vector<uint64_t> offs(cvlist.size() + 1, 0);
+  for (size_t i = 0; i < cvlist.size(); ++i)
+    offs[i + 1] = offs[i] + CVAinfo(cvlist[i]).nKstr;
+  hd.offName = alignup(sizeof(KDictHeader));
+  hd.offOffset = alignup(hd.offName + names.size());
+  hd.offId = alignup(hd.offOffset + offs.size() * sizeof(uint64_t));
+
+  string tfile = tmpName(fname);
+  FILE *fp;
+  if ((fp = fopen(tfile.c_str(), "wb")) == NULL) {
+    cerr << "Error happen on write dictionary file: " << fname << endl;
+    exit(1);
+  }
+  writeTo(fp, &hd, sizeof(KDictHeader), 1, fname);
+  padTo(fp, hd.offName);
+  writeTo(fp, names.data(), 1, names.size(), fname);
+  padTo(fp, hd.offOffset);
+  writeTo(fp, offs.data(), sizeof(uint64_t), offs.size(), fname);
+  padTo(fp, hd.offId);
+  vector<vector<uint32_t>> ids(nt);
+  for (size_t b = 0; b < cvlist.size(); b += nt) {
+    size_t e = min(cvlist.size(), b + nt);
+#pragma omp parallel for schedule(static, 1)
+    for (size_t i = b; i < e; ++i) {
+      vector<Kstr> ks;
+      readKstrs(cvlist[i], ks);
+      auto &id = ids[i - b];
+      id.resize(ks.size());
+      auto it = dict.begin();
+      for (size_t j = 0; j < ks.size(); ++j) {
+        it = lower_bound(it, dict.end(), ks[j]);
+        id[j] = it - dict.begin();
+      }
+    }
+    for (size_t i = b; i < e; ++i) {
+      if (ids[i - b].size() != offs[i + 1] - offs[i]) {
+        cerr << "The kstrs of " << cvlist[i] << " are changed" << endl;
+        exit(1);
+      }
+      writeTo(fp, ids[i - b].data(), sizeof(uint32_t), ids[i - b].size(),
+              fname);
+    }
+  }
+  closeTo(fp, fname);
+  renameTo(tfile, fname);
+};
+
+// map the file of the dictionary, which is valid if it is of the same CVAs
+bool KDict::read(const string &fname, const vector<string> &cvlist) {
+  auto m = make_shared<MMapFile>();
+  if (!m->open(fname) || m->size < sizeof(KDictHeader))
+    return false;
+  const KDictHeader &hd = *(const KDictHeader *)m->data;
+  if (memcmp(hd.magic, KDictHeader().magic, sizeof(hd.magic)) != 0 ||
+      hd.ncva != cvlist.size() || hd.offName > hd.offOffset ||
+      hd.offOffset > hd.offId || hd.offId > m->size ||
+      (hd.offId - hd.offOffset) / sizeof(uint64_t) < hd.ncva + 1)
+    return false;
+
+  // the names of CVAs in the same order
+  const char *p = m->data + hd.offName;
+  const char *pe = m->data + hd.offOffset;
+  unordered_map<string, size_t> nx;
+  for (auto &cv : cvlist) {
+    const char *q = (const char *)memchr(p, '\n', pe - p);
+    string name = getFileName(cv);
+    if (q == nullptr || name.compare(0, string::npos, p, q - p) != 0)
+      return false;
+    nx[name] = nx.size();
+    p = q + 1;
+  }
+  ArrayView<uint64_t> off((const uint64_t *)(m->data + hd.offOffset),
+                          hd.ncva + 1);
+  if (off[hd.ncva] > (m->size - hd.offId) / sizeof(uint32_t))
+    return false;
+
+  nkstr = hd.nkstr;
+  ndx.swap(nx);
+  offset = off;
+  id = ArrayView<uint32_t>((const uint32_t *)(m->data + hd.offId),
+                           off[hd.ncva]);
+  mf = m;
+  return true;
+};
+
+// the ids of the kstrs of a CVA, empty if the CVA is not in the dictionary
+ArrayView<uint32_t> KDict::ids(const string &fname) const {
+  auto it = ndx.find(getFileName(fname));
+  if (it == ndx.end())
+    return ArrayView<uint32_t>();
+  size_t b = offset[it->second], e = offset[it->second + 1];
+  return ArrayView<uint32_t>(id.begin() + b, e - b);
+};
@@ -14,6 +14,10 @@
 #ifndef CVARRAY_H
 #define CVARRAY_H
 
+#include <cstdio>
+#include <memory>
+#include <omp.h>
+#include <queue>
 #include <tuple>
 
 #include "cvmeth.h"
@@ -24,17 +28,152 @@ using namespace std;
 
 enum LPnorm { L0, L1, L2 };
 
+// the block of a kstr: the spans of gene indices and values of its items,
+// which are also iterated as Kitems for the loops on items
 struct Kblock {
-  vector<Kitem>::const_iterator _begin;
-  vector<Kitem>::const_iterator _end;
+  const int *_index = nullptr;
+  const float *_value = nullptr;
+  size_t _size = 0;
+
+  struct iterator {
+    const int *i;
+    const float *v;
+    Kitem operator*() const { return Kitem(*i, *v); };
+    iterator &operator++() {
+      ++i;
+      ++v;
+      return *this;
+    };
+    bool operator!=(const iterator &r) const { return i != r.i; };
+  };
 
   Kblock() = default;
-  Kblock(vector<Kitem>::const_iterator b, vector<Kitem>::const_iterator e)
-      : _begin(b), _end(e){};
+  Kblock(const int *i, const float *v, size_t n)
+      : _index(i), _value(v), _size(n){};
+
+  const int *index() const { return _index; };
+  const float *value() const { return _value; };
+  size_t size() const { return _size; };
+  iterator begin() const { return {_index, _value}; };
+  iterator end() const { return {_index + _size, _value + _size}; };
+};
+
+// the read-only view of an array, in a vector or in a mapped file
+template <typename T> struct ArrayView {
+  const T *_begin = nullptr;
+  const T *_end = nullptr;
+
+  ArrayView() = default;
+  ArrayView(const T *b, size_t n) : _begin(b), _end(b + n){};
+  ArrayView(const vector<T> &v) : _begin(v.data()), _end(v.data() + v.size()){};
+
+  const T *begin() const { return _begin; };
+  const T *end() const { return _end; };
+  size_t size() const { return _end - _begin; };
+  bool empty() const { return _end == _begin; };
+  const T &operator[](size_t i) const { return _begin[i]; };
+};
+
+struct CVAPack;
+
+// the header of the CVA file, the sections of cvdiminfo, kdiminfo and data
+// follow at their offsets aligned by 64 bytes. The kdiminfo and data sections
+// are the arrays of KdimInfo and Kitem in the version 2 file, the columns of
+// the postings (kstrs and gene indices) in the version 4 file, and the packed
+// columns of kstrs and indices in the version 3 file
+struct CVAHeader {
+  char magic[8] = {'C', 'V', 'A', 'R', 'R', 'A', 'Y', '\0'};
+  uint32_t version = 4;
+  uint32_t align = 64;
+  uint64_t nCV = 0;
+  uint64_t nKstr = 0;
+  uint64_t nItem = 0;
+  uint64_t offCV = 0;
+  uint64_t offKdim = 0;
+  uint64_t offData = 0;
+
+  CVAHeader() = default;
+  CVAHeader(size_t, size_t, size_t, CVAPack &);
+  bool valid(size_t) const;
+};
+
+// the other columns of the version 3 and 4 files after the header: the sizes
+// or the CSR offsets of kstr blocks, and the values quantized by vbits with a
+// scale. The values are exact if they are small integers kept without the
+// scale, or the floats of 32 bits in the version 4 file
+struct CVAPack {
+  uint64_t offSize = 0;
+  uint64_t offValue = 0;
+  uint32_t vbits = 16;
+  float scale = 1.0;
+  uint32_t exact = 0;
+  char reserved[36] = {0};
+};
+
+// the postings of kstrs in the structure of arrays: the kstrs, the CSR
+// offsets of their blocks, and the gene indices and the values of items.
+// The arrays are viewed in the mapped file of version 4, which is kept by
+// the postings, or in the vectors of their own when they are built, read
+// from the other files, or capped
+struct Postings {
+  ArrayView<Kstr> kstr;
+  ArrayView<uint32_t> offset;
+  ArrayView<int> index;
+  ArrayView<float> value;
+  vector<Kstr> kbuf;
+  vector<uint32_t> obuf;
+  vector<int> ibuf;
+  vector<float> vbuf;
+  shared_ptr<MMapFile> mf;
+
+  // the presence of kstrs by the ids of a dictionary, and the number of
+  // kstrs before every word of the bitmap
+  vector<uint64_t> bits;
+  vector<uint32_t> rank;
+
+  // the items by genes: the offsets of genes, and the kstr blocks and the
+  // values of items of a gene in the order of blocks. They are only for the
+  // matrix by rows, see setPost()
+  vector<uint32_t> goffset;
+  vector<uint32_t> gblock;
+  vector<float> gvalue;
+
+  // the kstrs dropped by the cap of genes in a block, with their sizes
+  vector<Kstr> dkstr;
+  vector<uint32_t> dsize;
+
+  Postings() = default;
+  Postings(const Postings &) = delete;
+  Postings &operator=(const Postings &) = delete;
+
+  void view();
+  void own();
+  void set(const ArrayView<KdimInfo> &, const ArrayView<Kitem> &);
+  void set(const vector<mlong> &, const vector<Kitem> &);
+  void setBits(const ArrayView<uint32_t> &, size_t);
+  void setGenes(size_t);
+  void cap(size_t, vector<Kitem> &);
+  size_t df(const Kstr &) const;
+  Kblock block(size_t i) const {
+    return Kblock(index.begin() + offset[i], value.begin() + offset[i],
+                  offset[i + 1] - offset[i]);
+  };
+};
 
-  vector<Kitem>::const_iterator begin() const { return _begin; };
-  vector<Kitem>::const_iterator end() const { return _end; };
-  size_t size() const { return _end - _begin; }
+// the packed columns of CVA: kstrs by delta varints, sizes of blocks by
+// varints, gene indices in a block by delta varints
+struct CVAColumns {
+  size_t nkstr = 0;
+  size_t nitem = 0;
+  vector<uint8_t> kstr, size, index;
+  vector<uint8_t> value;
+  CVAPack pack;
+  bool exact = true;
+
+  void encode(const Postings &);
+  float decode(size_t) const;
+  void setNorms(const Postings &, vector<CVdimInfo> &) const;
+  void write(FILE *, const ArrayView<CVdimInfo> &) const;
 };
 
 struct CVAinfo {
@@ -46,45 +185,154 @@ struct CVAinfo {
   CVAinfo(size_t nc, size_t nk, size_t ni) : nCV(nc), nKstr(nk), nItem(ni){};
   CVAinfo(const CVAinfo &rhs)
       : nCV(rhs.nCV), nKstr(rhs.nKstr), nItem(rhs.nItem){};
+  CVAinfo &operator=(const CVAinfo &) = default;
   CVAinfo(const string& fn){read(fn);};
+  CVAinfo(const CVAHeader &hd)
+      : nCV(hd.nCV), nKstr(hd.nKstr), nItem(hd.nItem){};
   void read(const string&); 
   friend ostream &operator<<(ostream &, const CVAinfo &);
 };
 
+// the header of the file of KDict, the names of CVAs, the CSR offsets of
+// their ids and the ids follow at their offsets aligned by 64 bytes
+struct KDictHeader {
+  char magic[8] = {'K', 'S', 'T', 'R', 'D', 'I', 'C', 'T'};
+  uint64_t nkstr = 0;
+  uint64_t ncva = 0;
+  uint64_t offName = 0;
+  uint64_t offOffset = 0;
+  uint64_t offId = 0;
+};
+
+// the dictionary of the kstrs in all genomes, a kstr is given the dense id
+// by its order in the dictionary. The ids of the kstrs of CVAs are kept in
+// the cache by the list of CVAs, and the file is mapped for the similarity
+struct KDict {
+  size_t nkstr = 0;
+  unordered_map<string, size_t> ndx;
+  ArrayView<uint64_t> offset;
+  ArrayView<uint32_t> id;
+  shared_ptr<MMapFile> mf;
+
+  bool read(const string &, const vector<string> &);
+  void build(const string &, const vector<string> &);
+  size_t size() const { return nkstr; };
+  ArrayView<uint32_t> ids(const string &) const;
+
+  static void unite(vector<vector<Kstr>> &);
+};
+
+// the CVs of genes inverted by kstr, the items are kept in the postings. The
+// cvdiminfo is in the vector when the CVA is built or read from the legacy
+// file, or viewed in the mapped file, so it should be accessed by cvdims()
 struct CVArray {
-  vector<KdimInfo> kdi;
   vector<CVdimInfo> cvdi;
-  vector<Kitem> data;
   vector<float> norm;
+  shared_ptr<MMapFile> mf;
+  ArrayView<CVdimInfo> cview;
+  enum LPnorm lp = L2;
+  Postings post;
 
   CVArray() = default;
   CVArray(const vector<CVvec> &cvs) { set(cvs); };
+  CVArray(vector<CVvec> &&cvs) { set(move(cvs)); };
   CVArray(const string &fname) { read(fname); };
-  CVArray(const string &fname, enum LPnorm normType) {
+  CVArray(const string &fname, enum LPnorm normType,
+          const KDict *dict = nullptr, size_t maxdf = 0, bool genes = false) {
     read(fname);
     setNorm(normType);
+    setPost(dict, fname, maxdf, genes);
   }
   void set(const vector<CVvec> &);
+  void set(vector<CVvec> &&);
+  void scatter(const vector<CVvec> &, vector<mlong> &, vector<Kitem> &);
+
+  ArrayView<CVdimInfo> cvdims() const { return mf ? cview : cvdi; };
 
   void setNorm(enum LPnorm);
-  Kblock getKblock(size_t) const;
+  void setPost(const KDict *, const string &, size_t maxdf = 0,
+               bool genes = false);
+  void capNorm(const vector<Kitem> &);
+  bool signedNorm() const;
+  size_t bytes() const;
+  Kblock getKblock(size_t i) const { return post.block(i); };
+  void getcvs(vector<CVvec> &) const;
 
   void read(const string &);
-  void write(const string &) const;
+  bool map(const string &);
+  bool unpack(const char *);
+  void write(const string &, enum CVAFormat fmt = V2) const;
 
   friend ostream &operator<<(ostream &, const CVArray &);
 };
 
-template <typename T>
-void alignSortVector(const vector<T> &va, const vector<T> &vb,
+// the items of CVs with their kstr, for the sorted runs spilled on disk
+typedef pair<mlong, Kitem> Kpost;
+
+// a sorted run on disk, read by chunks
+struct RunReader {
+  string fname;
+  FILE *fp = nullptr;
+  vector<Kpost> chunk;
+  size_t pos = 0;
+
+  RunReader(const string &, size_t);
+  ~RunReader();
+  bool valid() const { return pos < chunk.size(); };
+  const Kpost &item() const { return chunk[pos]; };
+  void next();
+  void fill();
+};
+
+// build the CVA file from the CVs added one by one. The items are buffered
+// within the memory budget, and spilled into sorted runs on disk when the
+// buffer is full. Then the runs are merged into the CVA file, by passes of
+// at most fanin runs to bound the number of opened files.
+struct CVAStream {
+  static constexpr size_t fanin = 256;
+  string fname;
+  enum CVAFormat fmt;
+  size_t nbuf;
+  size_t nrun = 0;
+  vector<CVdimInfo> cvdi;
+  vector<Kpost> buf, sbuf;
+  vector<string> runs;
+
+  CVAStream(const string &, size_t, enum CVAFormat fmt = V2);
+  void add(const CVvec &);
+  size_t close();
+
+  void sortbuf();
+  void spill();
+  void mergePass();
+  void merge();
+};
+
+// the file names of CVA: the legacy one with .gz suffix, and the version 2
+// one without it. The version 2 file is used first when both exist
+string cvabase(const string &);
+bool cvavalid(const string &);
+
+// whether the values of the CVA file are not quantized
+bool cvaexact(const string &);
+
+// the kstrs of the CVA file, by its column of kstrs only
+void readKstrs(const string &, vector<Kstr> &);
+
+template <typename V>
+void alignSortVector(const V &va, const V &vb,
                      vector<pair<size_t, size_t>> &aln) {
   auto itb = vb.begin();
   for (auto ita = va.begin(); ita != va.end(); ++ita) {
     itb = lower_bound(itb, vb.end(), *ita);
+    if (itb == vb.end())
+      break;
     if (*ita == *itb) {
       aln.emplace_back(ita - va.begin(), itb - vb.begin());
       ++itb;
     }
   }
 }
+void alignByBits(const Postings &, const Postings &,
+                 vector<pair<size_t, size_t>> &);
 #endif // !CVARRAY_H
@@ -31,6 +31,19 @@ CVmeth *CVmeth::create(const string &methStr, const string &cvdir,
   return meth;
 };
 
+void CVmeth::setCounter(const string &str) {
+  if (str == "hash") {
+    counter = HASH;
+  } else if (str == "sort") {
+    counter = SORT;
+  } else if (str == "auto") {
+    counter = AUTO;
+  } else {
+    cerr << "Unknow kmer counter: " << str << endl;
+    exit(3);
+  }
+};
+
 void CVmeth::setg(const string &gtype) {
   // init genome type read file
   theg.init(gtype);
@@ -57,32 +70,44 @@ void CVmeth::setCVdir(const string &str) {
   cvdir = str;
   if (str.empty()) {
     getCVname = [this](const string &str, size_t k) {
-      return str + cvsuff + to_string(k) + ".gz";
+      return str + kname(k) + ".gz";
     };
   } else {
     mkpath(cvdir);
     getCVname = [this](const string &str, size_t k) {
-      return cvdir + getFileName(str) + cvsuff + to_string(k) + ".gz";
+      return cvdir + keyname(str) + kname(k) + ".gz";
     };
   }
 }
 
+// the suffix of CVA for k, the packed CVA may be quantized, so it is apart
+// from the exact ones, as FileOption::cvsuf()
+string CVmeth::kname(size_t k) const {
+  return cvsuff + to_string(k) + (cvaFormat == PACKED ? ".pack" : "");
+};
+
+// the genome in cache is named by the hash of its content, see gkey
+string CVmeth::keyname(const string &gname) const {
+  auto it = gkey.find(gname);
+  return it == gkey.end() ? getFileName(gname) : it->second;
+}
+
 void CVmeth::execute(const string &gname, const vector<size_t> &klist,
                      bool chk) {
 
-  vector<pair<int, CVmap>> mcv;
+  vector<pair<int, CVvec>> mcv;
   // check the existed cvfile
   if (chk) {
     for (auto k : klist) {
       string cvfile = getCVname(gname, k);
       if (!gzvalid(cvfile)) {
-        CVmap cv;
+        CVvec cv;
         mcv.emplace_back(make_pair(k, cv));
       }
     }
   } else {
     for (auto k : klist) {
-      CVmap cv;
+      CVvec cv;
       mcv.emplace_back(make_pair(k, cv));
     }
   }
@@ -90,7 +115,7 @@ void CVmeth::execute(const string &gname, const vector<size_t> &klist,
   // calculate the CV
   if (!mcv.empty()) {
     // read genomes
-    Genome genome;
+    GenomeArena genome;
     theg.readgene(gname, genome);
 
     // get the cv of all K of the genome
@@ -104,18 +129,30 @@ void CVmeth::execute(const string &gname, const vector<size_t> &klist,
   }
 };
 
-void CVmeth::getcv(const string &fname, int k, vector<CVvec> &cvs) {
-
+void CVmeth::getcv(const string &fname, const vector<size_t> &klist,
+                   vector<vector<CVvec>> &mcvs, bool intra) {
   // read genomes
-  Genome genome;
+  GenomeArena genome;
   theg.readgene(fname, genome);
+  getcv(genome, klist, mcvs, intra);
+};
 
-  // get the cv in map format
-  vector<pair<int, CVmap>> mcv{make_pair(k, CVmap())};
-  for (auto &gene : genome) {
-    cv(gene, mcv);
-    cvs.emplace_back(cvmap2vec(mcv.front().second));
-    mcv.front().second.clear();
+void CVmeth::getcv(const GenomeArena &genome, const vector<size_t> &klist,
+                   vector<vector<CVvec>> &mcvs, bool intra) {
+  // get the cv of every gene for all k in one counting, the genes are split
+  // into threads if intra
+  mcvs.resize(klist.size());
+  size_t ibeg = mcvs.front().size();
+  for (auto &cvs : mcvs)
+    cvs.resize(ibeg + genome.size());
+#pragma omp parallel for schedule(dynamic, 64) if (intra)
+  for (size_t i = 0; i < genome.size(); ++i) {
+    vector<pair<int, CVvec>> mcv;
+    for (auto k : klist)
+      mcv.emplace_back(k, CVvec());
+    cv(genome[i], mcv);
+    for (size_t j = 0; j < klist.size(); ++j)
+      mcvs[j][ibeg + i].swap(mcv[j].second);
   }
 };
 
@@ -124,21 +161,21 @@ float CVmeth::getcv(const string &fname, int k, CVvec &aCV, bool save) {
   if (gzvalid(cvfile)) {
     return readcv(cvfile, aCV);
   } else {
-    vector<pair<int, CVmap>> mcv{make_pair(k, CVmap())};
+    vector<pair<int, CVvec>> mcv{make_pair(k, CVvec())};
 
     // read genomes
-    Genome genome;
+    GenomeArena genome;
     theg.readgene(fname, genome);
 
-    // get the cv in map format
+    // get the cv of the genome
     cv(genome, mcv);
 
     // save CV into file if required
     if (save)
       writecv(mcv.front().second, cvfile);
 
-    // convert CV map into CV vector
-    aCV = cvmap2vec(mcv.front().second);
+    // the sorted CV vector
+    aCV.swap(mcv.front().second);
     float norm = 0.0;
     for (auto &it : aCV)
       norm += it.second * it.second;
@@ -146,72 +183,313 @@ float CVmeth::getcv(const string &fname, int k, CVvec &aCV, bool save) {
   }
 };
 
-size_t CVmeth::getcva(const string &fname, int k) {
+size_t CVmeth::getcva(const string &fname, int k, bool intra) {
+  return getcva(fname, vector<size_t>{size_t(k)}, intra, false);
+};
+
+// get CVAs of all k from one reading of the genome
+size_t CVmeth::getcva(const string &fname, const vector<size_t> &klist,
+                      bool intra, bool chk) {
+  vector<size_t> kl;
+  for (auto k : klist) {
+    if (!chk || !cvavalid(getCVname(fname, k)))
+      kl.emplace_back(k);
+  }
+  if (kl.empty())
+    return 0;
+
+  if (cvaMemory > 0)
+    return streamcva(fname, kl);
+
+  GenomeArena genome;
+  theg.readgene(fname, genome);
+  return getcva(genome, fname, kl, intra);
+};
+
+// get CVAs of all k from the genome read
+size_t CVmeth::getcva(const GenomeArena &genome, const string &fname,
+                      const vector<size_t> &kl, bool intra) {
+  vector<vector<CVvec>> mcvs;
+  getcv(genome, kl, mcvs, intra);
+  for (size_t j = 0; j < kl.size(); ++j) {
+    CVArray cva(move(mcvs[j]));
+    cva.write(getCVname(fname, kl[j]), cvaFormat);
+  }
+
+  // the tails of genes for deriving the cva of shorter kmers
+  if (keepTail) {
+    vector<vector<GeneTail>> mgts(kl.size());
+    for (const auto &gene : genome)
+      gettail(gene, kl, mgts);
+    for (size_t j = 0; j < kl.size(); ++j)
+      writeTails(getTailname(fname, kl[j]), mgts[j]);
+  }
+  return genome.size();
+};
+
+/** the genome not hashed yet is read once for its hash and its CVAs, and its
+ * key is the hash with the suffix. The key is set in the slot of gkey made
+ * before threads. The CVAs cached by the same content, or derived from them,
+ * are not counted again, and the genomes of the same content in this run are
+ * counted by the first one hashed. The genome streamed within the memory
+ * budget is read again gene by gene */
+string CVmeth::hashcva(const string &fname, const vector<size_t> &klist,
+                       const string &suf, bool intra) {
+  GenomeArena genome;
+  theg.readgene(fname, genome);
+  ostringstream os;
+  os << hex << setw(16) << setfill('0') << genome.hash();
+  bool first;
+#pragma omp critical(hashcva)
+  {
+    gkey.find(fname)->second = os.str() + suf;
+    first = ghashed.insert(os.str()).second;
+  }
+  if (!first)
+    return os.str();
+
+  derivecva(fname, klist);
+  vector<size_t> kl;
+  for (auto k : klist) {
+    if (!cvavalid(getCVname(fname, k)))
+      kl.emplace_back(k);
+  }
+  if (kl.empty())
+    return os.str();
+  if (cvaMemory > 0) {
+    genome = GenomeArena();
+    streamcva(fname, kl);
+  } else {
+    getcva(genome, fname, kl, intra);
+  }
+  return os.str();
+};
+
+// get CVAs gene by gene within the memory budget shared by all k
+size_t CVmeth::streamcva(const string &fname, const vector<size_t> &klist) {
+  vector<CVAStream> vcvas;
+  vcvas.reserve(klist.size());
+  vector<vector<GeneTail>> mgts(klist.size());
+  vector<pair<int, CVvec>> mcv;
+  for (auto k : klist) {
+    vcvas.emplace_back(getCVname(fname, k), cvaMemory / klist.size(),
+                       cvaFormat);
+    mcv.emplace_back(k, CVvec());
+  }
+  theg.eachgene(fname, [&](const GeneView &gene) {
+    for (auto &item : mcv)
+      item.second.clear();
+    cv(gene, mcv);
+    for (size_t j = 0; j < klist.size(); ++j)
+      vcvas[j].add(mcv[j].second);
+    if (keepTail)
+      gettail(gene, klist, mgts);
+  });
+  size_t ng(0);
+  for (auto &cvas : vcvas)
+    ng = cvas.close();
+  if (keepTail) {
+    for (size_t j = 0; j < klist.size(); ++j)
+      writeTails(getTailname(fname, klist[j]), mgts[j]);
+  }
+  return ng;
+};
+
+// the length and the last k-1 residues of the gene for every k
+void CVmeth::gettail(const GeneView &gene, const vector<size_t> &klist,
+                     vector<vector<GeneTail>> &mgts) {
+  for (size_t j = 0; j < klist.size(); ++j) {
+    Kstr ks;
+    size_t n = min(gene.size(), klist[j] - 1);
+    for (size_t i = gene.size() - n; i < gene.size(); ++i)
+      ks.append(gene[i]);
+    mgts[j].emplace_back(gene.size(), ks);
+  }
+};
+
+/** derive the CVAs of shorter kmers from the cached CVA of a longer k and the
+ * tails of its genes. The (k-1)-mers of a gene are the prefixes of its k-mers
+ * and its last k-1 residues, while the gene not longer than k-1 keeps its CV.
+ * Only the counts of kmers can be derived in this way. */
+size_t CVmeth::derivecva(const string &fname, const vector<size_t> &klist) {
+  if (!keepTail)
+    return 0;
+
+  // the missing cva and the cached cva of a longer k to derive them
+  set<size_t> kset;
+  for (auto k : klist) {
+    if (!cvavalid(getCVname(fname, k)))
+      kset.insert(k);
+  }
+  if (kset.empty())
+    return 0;
+  // the quantized values of a packed cva are not the counts to be summed
+  size_t kh = *kset.begin() + 1;
+  for (; kh <= size_t(kmax); ++kh) {
+    if (kset.count(kh) == 0 && cvavalid(getCVname(fname, kh)) &&
+        cvaexact(getCVname(fname, kh)) && gzvalid(getTailname(fname, kh)))
+      break;
+  }
+  if (kh > size_t(kmax))
+    return 0;
+
+  // the cvs of genes and the tails of genes for k, the cvas are counted
+  // again if the tails are broken
   vector<CVvec> cvs;
-  getcv(fname, k, cvs);
-  CVArray cva(cvs);
-  cva.write(getCVname(fname, k));
-  return cva.cvdi.size();
+  CVArray(getCVname(fname, kh)).getcvs(cvs);
+  vector<GeneTail> gts;
+  if (!readTails(getTailname(fname, kh), gts, cvs.size()))
+    return 0;
+
+  for (size_t k = kh - 1; k >= *kset.begin(); --k) {
+    for (size_t i = 0; i < cvs.size(); ++i) {
+      size_t len = gts[i].first;
+      Kstr &tail = gts[i].second;
+      if (len < k)
+        continue;
+      if (len == k) {
+        tail.behead(k);
+        continue;
+      }
+
+      // merge the prefixes of kmers
+      CVvec &cv = cvs[i];
+      size_t n(0);
+      for (auto &cd : cv) {
+        cd.first.choptail();
+        if (n > 0 && cv[n - 1].first == cd.first)
+          cv[n - 1].second += cd.second;
+        else
+          cv[n++] = cd;
+      }
+      cv.resize(n);
+
+      // add the last kmer of the gene, then keep k-1 residues in the tail
+      auto it = lower_bound(
+          cv.begin(), cv.end(), tail,
+          [](const CVdim &a, const Kstr &b) { return a.first < b; });
+      if (it != cv.end() && it->first == tail)
+        it->second += 1.0;
+      else
+        cv.emplace(it, tail, 1.0);
+      tail.behead(k);
+    }
+
+    if (kset.count(k)) {
+      CVArray(cvs).write(getCVname(fname, k), cvaFormat);
+      writeTails(getTailname(fname, k), gts);
+    }
+  }
+  return cvs.size();
+};
+
+string CVmeth::getTailname(const string &fname, size_t k) {
+  string cvfile = getCVname(fname, k);
+  return cvfile.substr(0, cvfile.size() - 3) + ".tail.gz";
 };
 
-/** do bootstrape */
+/** do bootstrape: every gene is counted once, and the CV of a replicate is
+ * from the counts summed by the multiplicities of resampled genes. The
+ * replicate r of a genome is resampled by the seed of (seed, genome, r) */
 void CVmeth::bootstrap(const string &gname, const vector<size_t> &klist,
-                       const vector<string> &btdirs, bool chk) {
+                       const vector<string> &btdirs, size_t seed, bool chk) {
+  // initial cv containers
+  vector<vector<pair<int, CVvec>>> vmcv(btdirs.size());
+  bool done(true);
+  for (size_t r = 0; r < btdirs.size(); ++r) {
+    for (auto k : klist) {
+      if (!chk || !gzvalid(bootCVname(btdirs[r], gname, k)))
+        vmcv[r].emplace_back(make_pair(k, CVvec()));
+    }
+    done = done && vmcv[r].empty();
+  }
+  if (done)
+    return;
+
   // read genomes
-  Genome genome;
+  GenomeArena genome;
   theg.readgene(gname, genome);
 
-  // get cv for samples
-  for (auto &dir : btdirs) {
-    // initial cv container
-    vector<pair<int, CVmap>> mcv;
-    if (chk) {
-      for (auto k : klist) {
-        string cvfile = bootCVname(dir, gname, k);
-        if (!gzvalid(cvfile)) {
-          CVmap cv;
-          mcv.emplace_back(make_pair(k, cv));
-        }
-      }
-    } else {
-      for (auto k : klist) {
-        CVmap cv;
-        mcv.emplace_back(make_pair(k, cv));
-      }
+  // count every gene once for all lengths
+  set<int> slist = lengths(klist);
+  vector<GeneCounts> counts(*slist.rbegin() + 1);
+  withKstr(*slist.rbegin(), genome.minlen(), [&](auto tag) {
+    typedef decltype(tag) K;
+    vector<KVec<K>> mkv;
+    vector<double> nstr;
+    for (const auto &gene : genome) {
+      count(gene, slist, mkv, nstr);
+      // the gene shorter than k is counted negative, as in the genome sum
+      for (auto k : slist)
+        counts[k].add(mkv[k], double(long(gene.size()) - k + 1));
     }
+  });
+  for (auto k : slist)
+    counts[k].finish();
+
+  // the seed of genome by its name
+  uint32_t gseed(2166136261u);
+  for (auto c : getFileName(gname))
+    gseed = (gseed ^ (unsigned char)c) * 16777619u;
+
+  // get cv for samples
+#pragma omp parallel for schedule(dynamic)
+  for (size_t r = 0; r < btdirs.size(); ++r) {
+    if (vmcv[r].empty())
+      continue;
+
+    // the multiplicities of resampled genes
+    seed_seq sseq{uint32_t(seed), gseed, uint32_t(r)};
+    mt19937 gen(sseq);
+    uniform_int_distribution<> distrib(0, genome.size() - 1);
+    Resample rs{&counts, vector<double>(genome.size(), 0.0), genome.minlen(),
+                size_t(*slist.rbegin())};
+    for (size_t i = 0; i < genome.size(); ++i)
+      ++rs.weight[distrib(gen)];
 
     // get the cv of all K for the bootstrap genome
-    cv(bootGenome(genome), mcv);
+    cv(rs, vmcv[r]);
 
     // write down CVs
-    for (auto item : mcv) {
-      string outfile = bootCVname(dir, gname, item.first);
+    for (auto &item : vmcv[r]) {
+      string outfile = bootCVname(btdirs[r], gname, item.first);
       writecv(item.second, outfile);
     }
+    vmcv[r].clear();
   }
 };
 
-Genome CVmeth::bootGenome(const Genome &org) {
-  int ng = org.size();
-  random_device rd;
-  mt19937 gen(rd());
-  uniform_int_distribution<> distrib(0, ng - 1);
+string CVmeth::bootCVname(const string &sdir, const string &gname, size_t k) {
+  return sdir + getFileName(gname) + cvsuff + to_string(k) + ".gz";
+}
 
-  Genome gs(ng);
-  for (auto &g : gs) {
-    int ndx = distrib(gen);
-    g = org[ndx];
+// select the kstring type for counting: bit-packed by the alphabet of genome,
+// or the Kstr. The gene shorter than k is kept as a short kstring, which only
+// Kstr can tell from a k-mer.
+template <typename F>
+void CVmeth::withKstr(size_t k, size_t minlen, F f) const {
+  if (minlen >= k && theg.alphabet == AMINO &&
+      k <= PackedKstr<AminoAcid>::kmax) {
+    f(PackedKstr<AminoAcid>());
+  } else if (minlen >= k && theg.alphabet == NUCLEO &&
+             k <= PackedKstr<Nucleotide>::kmax) {
+    f(PackedKstr<Nucleotide>());
+  } else {
+    f(Kstr());
   }
+};
 
-  return gs;
+// the length selecting the kstring type for the longest k of a sequence,
+// the counts of a resampled genome are typed by the one of their counting
+template <typename T> static size_t typeLength(const T &, size_t k) {
+  return k;
 };
 
-string CVmeth::bootCVname(const string &sdir, const string &gname, size_t k) {
-  return sdir + getFileName(gname) + cvsuff + to_string(k) + ".gz";
-}
+static size_t typeLength(const Resample &rs, size_t) { return rs.ktype; };
 
 // count the kmers
-size_t CVmeth::count(const Genome &genome, size_t k, CVmap &cv) {
+template <typename K>
+size_t CVmeth::count(const GenomeArena &genome, size_t k, KCount<K> &cv) {
   size_t n(0);
   for (const auto &gene : genome) {
     // the number of kstring of the gene
@@ -220,113 +498,536 @@ size_t CVmeth::count(const Genome &genome, size_t k, CVmap &cv) {
   return n;
 };
 
-size_t CVmeth::count(const Gene &gene, size_t k, CVmap &cv) {
+template <typename K>
+size_t CVmeth::count(const GeneView &gene, size_t k, KCount<K> &cv) {
   // get the first k string
-  Kstr ks(gene.substr(0, k));
-  CVmap::iterator iter = cv.find(ks);
-  if (iter == cv.end()) {
-    cv[ks] = 1.0;
+  K ks(gene.head(k));
+  ++cv[ks];
+
+  // get the next kstring
+  for (size_t i = k; i < gene.size(); ++i) {
+    ks.forward(gene[i], k);
+    ++cv[ks];
+  }
+
+  return gene.size() - k + 1;
+};
+
+// count the kmers by sorting: the kstrings of all windows are pushed into a
+// reused buffer, sorted by radix and collapsed by runs
+template <typename K>
+size_t CVmeth::count(const GenomeArena &genome, size_t k, KVec<K> &kv) {
+  size_t n(0);
+  if (useDense(k, genome.minlen(), genome.length())) {
+    DenseCounter<K> &dc = theDenseCounter<K>(k);
+    for (const auto &gene : genome)
+      n += dc.count(gene);
+    dc.collapse(kv);
   } else {
-    ++(iter->second);
+    static thread_local vector<K> kbuf;
+    kbuf.clear();
+    kbuf.reserve(genome.length());
+    for (const auto &gene : genome)
+      n += kstrings(gene, k, kbuf);
+    collapse(kbuf, kv);
   }
+  return n;
+};
 
-  // get the next kstring
-  for (int i = k; i < gene.size(); ++i) {
-    ks.behead();
+template <typename K>
+size_t CVmeth::count(const GeneView &gene, size_t k, KVec<K> &kv) {
+  size_t n(0);
+  if (useDense(k, gene.size())) {
+    DenseCounter<K> &dc = theDenseCounter<K>(k);
+    n = dc.count(gene);
+    dc.collapse(kv);
+  } else {
+    static thread_local vector<K> kbuf;
+    kbuf.clear();
+    n = kstrings(gene, k, kbuf);
+    collapse(kbuf, kv);
+  }
+  return n;
+};
+
+// the dense counter is used when all kmers fit in the bound. For a genome,
+// the sequence should be long enough to cover the slots, otherwise the random
+// access of slots is slower than sorting the kmers in cache. A gene has no
+// such test: the slots of the thread are kept between genes and reset by the
+// touched list, so the cost of a gene is its length
+bool CVmeth::useDense(size_t k, size_t minlen, size_t len) const {
+  if (counter != AUTO || minlen < k)
+    return false;
+  size_t nslot(1);
+  for (size_t i = 0; i < k; ++i) {
+    nslot *= theg.letters.size();
+    if (nslot > denseMax || nslot > len)
+      return false;
+  }
+  return true;
+};
+
+// the dense counters of the thread, one for each k, so that the methods
+// counting several lengths do not reset the slots for every gene
+template <typename K>
+DenseCounter<K> &CVmeth::theDenseCounter(size_t k) const {
+  static thread_local vector<DenseCounter<K>> dcs;
+  if (dcs.size() <= k)
+    dcs.resize(k + 1);
+  dcs[k].init(theg.letters.size(), k);
+  return dcs[k];
+};
+
+// count the kmers of the listed lengths, indexed by the length
+template <typename K, typename T>
+void CVmeth::count(const T &seq, const set<int> &slist,
+                   vector<KCount<K>> &mkc, vector<double> &nstr) {
+  mkc.resize(*slist.rbegin() + 1);
+  nstr.resize(*slist.rbegin() + 1);
+  for (auto k : slist) {
+    KCount<K>().swap(mkc[k]);
+    nstr[k] = count(seq, k, mkc[k]);
+  }
+};
+
+// count the longest kmers in one sweep, and the shorter ones are the
+// prefixes of the longer ones plus the tail of every gene. It requires the
+// genes not shorter than the longest k, and the order of prefix kept in K.
+template <typename K, typename T>
+void CVmeth::count(const T &seq, const set<int> &slist, vector<KVec<K>> &mkv,
+                   vector<double> &nstr) {
+  size_t klong = *slist.rbegin();
+  mkv.resize(klong + 1);
+  nstr.resize(klong + 1);
+  if (is_same<K, Kstr>::value) {
+    for (auto k : slist)
+      nstr[k] = count(seq, k, mkv[k]);
+  } else {
+    static thread_local vector<K> kbuf;
+    static thread_local KVec<K> tv;
+    nstr[klong] = count(seq, klong, mkv[klong]);
+    for (size_t k = klong - 1; k >= size_t(*slist.begin()); --k) {
+      kbuf.clear();
+      nstr[k] = nstr[k + 1] + tails(seq, k, kbuf);
+      collapse(kbuf, tv);
+      shorten(mkv[k + 1], tv, mkv[k]);
+    }
+  }
+};
+
+// the last kmer of genes, which is not a prefix of the longer kmer
+template <typename K>
+size_t CVmeth::tails(const GenomeArena &genome, size_t k, vector<K> &kbuf) {
+  for (const auto &gene : genome)
+    tails(gene, k, kbuf);
+  return genome.size();
+};
+
+template <typename K>
+size_t CVmeth::tails(const GeneView &gene, size_t k, vector<K> &kbuf) {
+  K ks;
+  for (size_t i = gene.size() - k; i < gene.size(); ++i)
     ks.append(gene[i]);
-    CVmap::iterator iter = cv.find(ks);
-    if (iter == cv.end()) {
-      cv[ks] = 1.0;
+  kbuf.emplace_back(ks);
+  return 1;
+};
+
+// merge the prefixes of sorted kmers and the sorted tails into sorted counts
+template <typename K>
+void CVmeth::shorten(const KVec<K> &lkv, const KVec<K> &tv, KVec<K> &kv) {
+  kv.clear();
+  auto tit = tv.begin();
+  for (const auto &it : lkv) {
+    K ks = it.first;
+    ks.choptail();
+    if (!kv.empty() && kv.back().first == ks) {
+      kv.back().second += it.second;
     } else {
-      ++(iter->second);
+      for (; tit != tv.end() && tit->first < ks; ++tit)
+        kv.emplace_back(*tit);
+      if (tit != tv.end() && tit->first == ks) {
+        kv.emplace_back(ks, it.second + tit->second);
+        ++tit;
+      } else {
+        kv.emplace_back(ks, it.second);
+      }
     }
   }
+  kv.insert(kv.end(), tit, tv.end());
+};
 
-  return gene.size() - k + 1;
+// count the kmers of the resampled genome
+template <typename K>
+size_t CVmeth::count(const Resample &rs, size_t k, KCount<K> &kc) {
+  static thread_local KVec<K> kv;
+  double n = (*rs.counts)[k].sum(rs.weight, kv);
+  for (const auto &it : kv)
+    kc[it.first] += it.second;
+  return n;
 };
 
-// The Count Method
-void Counting::cv(const Genome &genome, vector<pair<int, CVmap>> &vcv) {
-  for (auto &item : vcv) {
-    count(genome, item.first, item.second);
+template <typename K>
+size_t CVmeth::count(const Resample &rs, size_t k, KVec<K> &kv) {
+  return (*rs.counts)[k].sum(rs.weight, kv);
+};
+
+template <typename K>
+void CVmeth::count(const Resample &rs, const set<int> &slist,
+                   vector<KVec<K>> &mkv, vector<double> &nstr) {
+  mkv.resize(*slist.rbegin() + 1);
+  nstr.resize(*slist.rbegin() + 1);
+  for (auto k : slist)
+    nstr[k] = count(rs, k, mkv[k]);
+};
+
+template <typename K>
+size_t CVmeth::kstrings(const GeneView &gene, size_t k, vector<K> &kbuf) {
+  K ks(gene.head(k));
+  kbuf.emplace_back(ks);
+  for (size_t i = k; i < gene.size(); ++i) {
+    ks.forward(gene[i], k);
+    kbuf.emplace_back(ks);
   }
+  return gene.size() - k + 1;
 };
 
-void Counting::cv(const Gene &gene, vector<pair<int, CVmap>> &vcv) {
-  for (auto &item : vcv) {
-    count(gene, item.first, item.second);
+template <typename K> void CVmeth::collapse(vector<K> &kbuf, KVec<K> &kv) {
+  // sort the kstrings
+  static thread_local vector<K> sbuf;
+  mlong kmax(0);
+  for (const auto &ks : kbuf)
+    kmax = max(kmax, ks.ks);
+  radixSort(kbuf, sbuf, nbitOf(kmax), [](const K &a) { return a.ks; });
+
+  // collapse the runs into counts
+  kv.clear();
+  for (const auto &ks : kbuf) {
+    if (kv.empty() || !(kv.back().first == ks))
+      kv.emplace_back(ks, 1.0);
+    else
+      ++kv.back().second;
   }
 };
 
+// The Count Method
+template <typename T>
+void Counting::docv(const T &seq, size_t minlen,
+                    vector<pair<int, CVvec>> &vcv) {
+  set<int> slist;
+  for (auto &item : vcv)
+    slist.insert(item.first);
+
+  withKstr(typeLength(seq, *slist.rbegin()), minlen, [&](auto tag) {
+    typedef decltype(tag) K;
+    if (counter == HASH) {
+      for (auto &item : vcv) {
+        // reuse the buckets of counter between genes, but not the huge one
+        static thread_local KCount<K> kc;
+        count(seq, item.first, kc);
+        kcount2cv(kc, item.first, item.second);
+        if (kc.bucket_count() > (1UL << 16))
+          KCount<K>().swap(kc);
+        else
+          kc.clear();
+      }
+    } else {
+      static thread_local vector<KVec<K>> mkv;
+      static thread_local vector<double> nstr;
+      count(seq, slist, mkv, nstr);
+      for (auto &item : vcv)
+        kcount2cv(mkv[item.first], item.first, item.second);
+    }
+  });
+};
+
+set<int> Counting::lengths(const vector<size_t> &klist) const {
+  return set<int>(klist.begin(), klist.end());
+};
+
+void Counting::cv(const Resample &rs, vector<pair<int, CVvec>> &vcv) {
+  docv(rs, rs.minlen, vcv);
+};
+
+void Counting::cv(const GenomeArena &genome, vector<pair<int, CVvec>> &vcv) {
+  docv(genome, genome.minlen(), vcv);
+};
+
+void Counting::cv(const GeneView &gene, vector<pair<int, CVvec>> &vcv) {
+  docv(gene, gene.size(), vcv);
+};
+
 // Hao method based the Markov Model
-void HaoMethod::cv(const Genome &genome, vector<pair<int, CVmap>> &vcv) {
-  docv(genome, vcv);
+set<int> HaoMethod::lengths(const vector<size_t> &klist) const {
+  set<int> slist;
+  for (auto k : klist) {
+    slist.insert(k);
+    slist.insert(k - 1);
+    slist.insert(k - 2);
+  }
+  return slist;
+};
+
+void HaoMethod::cv(const Resample &rs, vector<pair<int, CVvec>> &vcv) {
+  docv(rs, rs.minlen, vcv);
 }
 
-void HaoMethod::cv(const Gene &gene, vector<pair<int, CVmap>> &vcv) {
-  docv(gene, vcv);
+void HaoMethod::cv(const GenomeArena &genome, vector<pair<int, CVvec>> &vcv) {
+  docv(genome, genome.minlen(), vcv);
+}
+
+void HaoMethod::cv(const GeneView &gene, vector<pair<int, CVvec>> &vcv) {
+  docv(gene, gene.size(), vcv);
 }
 
 template <typename T>
-void HaoMethod::docv(const T &seq, vector<pair<int, CVmap>> &vcv) {
+void HaoMethod::docv(const T &seq, size_t minlen,
+                     vector<pair<int, CVvec>> &vcv) {
+  // the kstring type for the longest k
+  size_t kmax(0);
+  for (auto &item : vcv)
+    kmax = max(kmax, size_t(item.first));
+  withKstr(typeLength(seq, kmax), minlen, [&](auto tag) {
+    typedef decltype(tag) K;
+    if (counter == HASH)
+      docv<K, KCount<K>>(seq, vcv);
+    else
+      docv<K, KVec<K>>(seq, vcv);
+  });
+};
+
+template <typename K, typename C, typename T>
+void HaoMethod::docv(const T &seq, vector<pair<int, CVvec>> &vcv) {
 
   // require k to count
-  set<int> slist;
-  for (auto &item : vcv) {
-    slist.insert(item.first);
-    slist.insert(item.first - 1);
-    slist.insert(item.first - 2);
-  }
+  vector<size_t> klist;
+  for (auto &item : vcv)
+    klist.emplace_back(item.first);
+  set<int> slist = lengths(klist);
 
-  // count k string
-  map<int, CVmap> mvc;
-  map<int, double> nstr;
-  for (auto &k : slist) {
-    CVmap cv;
-    nstr[k] = count(seq, k, cv);
-    mvc[k] = cv;
-  }
+  // count k string of all lengths, indexed by the length
+  static thread_local vector<C> mvc;
+  static thread_local vector<double> nstr;
+  count(seq, slist, mvc, nstr);
 
   // get the cv with subtract
   for (auto &item : vcv) {
     int k = item.first;
     double factor = nstr[k] * nstr[k - 2] / (nstr[k - 1] * nstr[k - 1]);
-    markov(mvc[k], mvc[k - 1], mvc[k - 2], factor, item.second);
+    KVec<K> kv;
+    markov(mvc[k], mvc[k - 1], mvc[k - 2], k, factor, kv);
+    kcount2cv(kv, k, item.second);
   }
 };
 
-void HaoMethod::markov(const CVmap &mck, const CVmap &mckM1, const CVmap &mckM2,
-                       double factor, CVmap &cv) {
+template <typename K, typename C>
+void HaoMethod::markov(const C &mck, const C &mckM1, const C &mckM2, size_t k,
+                       double factor, KVec<K> &cv) {
 
-  CVmap::const_iterator iter;
+  Residue nc = Kstr::charSet.size();
+  const double *iter;
   for (const auto &cd : mckM2) {
-    Kstr ksM2 = cd.first;
+    K ksM2 = cd.first;
     double nksM2 = cd.second;
-    for (auto &c : ksM2.charSet) {
-      Kstr ksM1A = ksM2;
+    // the Kstr of a gene shorter than k-2 takes the head at its own length
+    size_t lenM2 = k - 2;
+    if constexpr (is_same<K, Kstr>::value)
+      lenM2 = ksM2.length();
+    for (Residue c = 1; c <= nc; ++c) {
+      K ksM1A = ksM2;
       ksM1A.append(c);
-      iter = mckM1.find(ksM1A);
-      if (iter != mckM1.end()) {
-        double nksM1A = iter->second;
-
-        for (auto &d : ksM2.charSet) {
-          Kstr ksM1B = ksM2;
-          ksM1B.addhead(d);
-          iter = mckM1.find(ksM1B);
-          if (iter != mckM1.end()) {
-            double nksM1B = iter->second;
+      iter = kfind(mckM1, ksM1A);
+      if (iter != nullptr) {
+        double nksM1A = *iter;
+
+        for (Residue d = 1; d <= nc; ++d) {
+          K ksM1B = ksM2;
+          ksM1B.addhead(d, lenM2);
+          iter = kfind(mckM1, ksM1B);
+          if (iter != nullptr) {
+            double nksM1B = *iter;
             double nks0 = factor * nksM1B * nksM1A / nksM2;
 
-            Kstr ks = ksM1B;
+            K ks = ksM1B;
             ks.append(c);
-            iter = mck.find(ks);
+            iter = kfind(mck, ks);
             double nks = 0;
-            if (iter != mck.end())
-              nks = iter->second;
-            cv[ks] = (nks - nks0) / nks0;
+            if (iter != nullptr)
+              nks = *iter;
+            cv.emplace_back(ks, (nks - nks0) / nks0);
           }
         }
       }
     }
   }
-};
\ No newline at end of file
+
+  // sort the cv by kstring
+  static thread_local KVec<K> sbuf;
+  mlong kmax(0);
+  for (const auto &cd : cv)
+    kmax = max(kmax, cd.first.ks);
+  radixSort(cv, sbuf, nbitOf(kmax),
+            [](const pair<K, double> &a) { return a.first.ks; });
+};
+
+// the Markov subtraction by merging the sorted counts, for every kmer
+// d.m.c, the (k-1)mer d.m runs over the sorted counts of k-1, and the (k-1)mer
+// m.c runs over the block of m in the counts of k-1. So the kmers come out in
+// order, and every lookup is a pointer moving forward.
+template <typename K>
+void HaoMethod::markov(const KVec<K> &mck, const KVec<K> &mckM1,
+                       const KVec<K> &mckM2, size_t k, double factor,
+                       KVec<K> &cv) {
+
+  // the Kstr keeps the short kstring of the gene shorter than k
+  if constexpr (is_same<K, Kstr>::value) {
+    markov<K, KVec<K>>(mck, mckM1, mckM2, k, factor, cv);
+  } else {
+    // the block of (k-1)mers with the prefix of every (k-2)mer
+    static thread_local vector<size_t> block;
+    block.resize(mckM2.size() + 1);
+    size_t ib(0);
+    for (size_t i = 0; i < mckM2.size(); ++i) {
+      block[i] = ib;
+      for (; ib < mckM1.size(); ++ib) {
+        K ks = mckM1[ib].first;
+        ks.choptail();
+        if (!(ks == mckM2[i].first))
+          break;
+      }
+    }
+    block.back() = ib;
+
+    // the position in the counts of (k-2)mers for every head residue
+    static thread_local vector<size_t> pos;
+    pos.assign(Kstr::charSet.size() + 1, 0);
+
+    auto iter = mck.begin();
+    for (const auto &cdB : mckM1) {
+      // find the (k-2)mer m of d.m
+      K ksM2 = cdB.first;
+      size_t &im = pos[ksM2.head(k - 1)];
+      ksM2.behead(k - 1);
+      while (mckM2[im].first < ksM2)
+        ++im;
+      double nksM2 = mckM2[im].second;
+      double nksM1B = cdB.second;
+
+      // all the (k-1)mers m.c
+      for (size_t ia = block[im]; ia < block[im + 1]; ++ia) {
+        double nksM1A = mckM1[ia].second;
+        double nks0 = factor * nksM1B * nksM1A / nksM2;
+
+        K ks = cdB.first;
+        ks.append(mckM1[ia].first.tail());
+        while (iter != mck.end() && iter->first < ks)
+          ++iter;
+        double nks = 0;
+        if (iter != mck.end() && iter->first == ks)
+          nks = iter->second;
+        cv.emplace_back(ks, (nks - nks0) / nks0);
+      }
+    }
+  }
+};
+
+/*************************************************************
+ * The dense counter indexed by the kmer in base of alphabet
+ *************************************************************/
+template <typename K> void DenseCounter<K>::init(size_t nc, size_t kk) {
+  if (nc == nbase && kk == k)
+    return;
+  nbase = nc;
+  k = kk;
+  lead = 1;
+  for (size_t i = 1; i < k; ++i)
+    lead *= nbase;
+  slot.assign(lead * nbase, 0);
+  touched.clear();
+};
+
+template <typename K> size_t DenseCounter<K>::count(const GeneView &gene) {
+  // the first kmer
+  K ks(gene.head(k));
+  uint32_t ndx(0);
+  for (size_t i = 0; i < k; ++i)
+    ndx = ndx * nbase + gene[i] - 1;
+  add(ndx, ks);
+
+  // slide by removing the leading residue of the window
+  for (size_t i = k; i < gene.size(); ++i) {
+    ndx = (ndx - uint32_t(gene[i - k] - 1) * lead) * nbase + gene[i] - 1;
+    ks.forward(gene[i], k);
+    add(ndx, ks);
+  }
+  return gene.size() - k + 1;
+};
+
+template <typename K> void DenseCounter<K>::collapse(KVec<K> &kv) {
+  // sort the touched slots, the order of index is the order of kstring
+  radixSort(touched, sbuf, nbitOf(lead * nbase - 1),
+            [](const pair<uint32_t, K> &a) { return a.first; });
+
+  // get counts and reset the slots
+  kv.clear();
+  kv.reserve(touched.size());
+  for (const auto &it : touched) {
+    kv.emplace_back(it.second, slot[it.first]);
+    slot[it.first] = 0;
+  }
+  touched.clear();
+};
+
+/*************************************************************
+ * The counts of kmers in genes for the resampled genomes
+ *************************************************************/
+template <typename K> void GeneCounts::add(const KVec<K> &kv, double n) {
+  int ndx = nkstr.size();
+  nkstr.emplace_back(n);
+  for (const auto &it : kv)
+    items.emplace_back(it.first.ks, make_pair(ndx, float(it.second)));
+};
+
+// sort the items by kmer, the stable sort keeps the order of gene
+void GeneCounts::finish() {
+  mlong kmax(0);
+  for (const auto &it : items)
+    kmax = max(kmax, it.first);
+  {
+    vector<pair<mlong, pair<int, float>>> buf;
+    radixSort(items, buf, nbitOf(kmax),
+              [](const pair<mlong, pair<int, float>> &a) { return a.first; });
+  }
+
+  post.reserve(items.size());
+  for (const auto &it : items) {
+    if (kstr.empty() || kstr.back() != it.first) {
+      if (!kstr.empty())
+        offset.emplace_back(post.size());
+      kstr.emplace_back(it.first);
+    }
+    post.emplace_back(it.second);
+  }
+  offset.emplace_back(post.size());
+  vector<pair<mlong, pair<int, float>>>().swap(items);
+};
+
+// the counts of kmers summed by the weights of genes, and return the total
+template <typename K>
+double GeneCounts::sum(const vector<double> &w, KVec<K> &kv) const {
+  kv.clear();
+  for (size_t i = 0; i < kstr.size(); ++i) {
+    double n(0);
+    for (size_t j = offset[i]; j < offset[i + 1]; ++j)
+      n += w[post[j].first] * post[j].second;
+    if (n > 0) {
+      K ks;
+      ks.ks = kstr[i];
+      kv.emplace_back(ks, n);
+    }
+  }
+
+  double nt(0);
+  for (size_t i = 0; i < nkstr.size(); ++i)
+    nt += w[i] * nkstr[i];
+  return nt;
+};
@@ -27,17 +27,71 @@
 #include <unordered_map>
 #include <vector>
 
+#include "karray.h"
 #include "kit.h"
 #include "kstring.h"
 #include "readgenome.h"
 #include "stringOpt.h"
 #include "cvarray.h"
 
+// the engine to count kmers: by hash map, by sorting, or automatically by
+// the dense array for small k and by sorting for others
+enum Counter { HASH, SORT, AUTO };
+
+// the counter with a slot for every kmer, only the touched slots are
+// collected and reset, so the cost is proportional to the length of gene
+template <typename K> struct DenseCounter {
+  size_t nbase = 0;
+  size_t k = 0;
+  uint32_t lead = 0;
+  vector<uint32_t> slot;
+  vector<pair<uint32_t, K>> touched;
+  vector<pair<uint32_t, K>> sbuf;
+
+  void init(size_t, size_t);
+  size_t count(const GeneView &);
+  void collapse(KVec<K> &);
+  void add(uint32_t ndx, const K &ks) {
+    if (slot[ndx]++ == 0)
+      touched.emplace_back(ndx, ks);
+  };
+};
+
+// the counts of kmers with a length in every gene, inverted by the kmer
+struct GeneCounts {
+  vector<mlong> kstr;
+  vector<size_t> offset{0};
+  vector<pair<int, float>> post;
+  vector<double> nkstr;
+  vector<pair<mlong, pair<int, float>>> items;
+
+  template <typename K> void add(const KVec<K> &, double);
+  void finish();
+  template <typename K> double sum(const vector<double> &, KVec<K> &) const;
+};
+
+// the resampled genome, the counts of the original genes by their weights.
+// The minlen of the original genome and the longest length counted select
+// the kstring type of the counts, whatever lengths a replicate still needs
+struct Resample {
+  const vector<GeneCounts> *counts;
+  vector<double> weight;
+  size_t minlen;
+  size_t ktype;
+};
+
 struct CVmeth {
 
   GeneType theg;
+  enum Counter counter = AUTO;
+  size_t denseMax = 1UL << 23;
+  size_t cvaMemory = 0;
+  enum CVAFormat cvaFormat = V2;
+  bool keepTail = false;
   string cvsuff = ".Hao";
   string cvdir;
+  map<string, string> gkey;
+  set<string> ghashed;
   int kmin = 1;
   int kmax = 14;
 
@@ -48,9 +102,13 @@ struct CVmeth {
   void init(const string &, const string &);
   void setCVdir(const string &);
   void setg(const string &);
+  void setCounter(const string &);
 
   // get the cvname for diffent cvdir
   function<string(const string &, size_t)> getCVname;
+  string keyname(const string &) const;
+  string kname(size_t) const;
+  string getTailname(const string &, size_t);
 
   // from genome to cv
   void checkK(const vector<size_t> &);
@@ -58,41 +116,102 @@ struct CVmeth {
 
   // execute the caculate
   void execute(const string &, const vector<size_t> &, bool chk = true);
-  void getcv(const string&, int, vector<CVvec>&);
+  void getcv(const string &, const vector<size_t> &, vector<vector<CVvec>> &,
+             bool intra = false);
+  void getcv(const GenomeArena &, const vector<size_t> &,
+             vector<vector<CVvec>> &, bool intra = false);
   float getcv(const string&, int, CVvec&, bool save=false);
-  size_t getcva(const string&, int);
+  size_t getcva(const string&, int, bool intra = false);
+  size_t getcva(const string &, const vector<size_t> &, bool intra = false,
+                bool chk = true);
+  size_t getcva(const GenomeArena &, const string &, const vector<size_t> &,
+                bool intra = false);
+  string hashcva(const string &, const vector<size_t> &, const string &,
+                 bool intra = false);
+  size_t streamcva(const string &, const vector<size_t> &);
+  size_t derivecva(const string &, const vector<size_t> &);
+  void gettail(const GeneView &, const vector<size_t> &,
+               vector<vector<GeneTail>> &);
 
   // bootstrap genome
-  Genome bootGenome(const Genome &);
   string bootCVname(const string&, const string&, size_t);
   void bootstrap(const string &, const vector<size_t> &, const vector<string> &,
-                 bool chk = true);
+                 size_t, bool chk = true);
 
   // basic function for the method
-  size_t count(const Genome &, size_t, CVmap &);
-  size_t count(const Gene&, size_t, CVmap &);
+  template <typename F> void withKstr(size_t, size_t, F) const;
+  template <typename K>
+  size_t count(const GenomeArena &, size_t, KCount<K> &);
+  template <typename K>
+  size_t count(const GeneView &, size_t, KCount<K> &);
+  template <typename K>
+  size_t count(const GenomeArena &, size_t, KVec<K> &);
+  template <typename K>
+  size_t count(const GeneView &, size_t, KVec<K> &);
+  template <typename K, typename T>
+  void count(const T &, const set<int> &, vector<KCount<K>> &,
+             vector<double> &);
+  template <typename K, typename T>
+  void count(const T &, const set<int> &, vector<KVec<K>> &, vector<double> &);
+  template <typename K>
+  size_t tails(const GenomeArena &, size_t, vector<K> &);
+  template <typename K>
+  size_t tails(const GeneView &, size_t, vector<K> &);
+  template <typename K>
+  void shorten(const KVec<K> &, const KVec<K> &, KVec<K> &);
+  template <typename K>
+  size_t count(const Resample &, size_t, KCount<K> &);
+  template <typename K>
+  size_t count(const Resample &, size_t, KVec<K> &);
+  template <typename K>
+  void count(const Resample &, const set<int> &, vector<KVec<K>> &,
+             vector<double> &);
+  template <typename K>
+  size_t kstrings(const GeneView &, size_t, vector<K> &);
+  template <typename K> void collapse(vector<K> &, KVec<K> &);
+  bool useDense(size_t, size_t, size_t = SIZE_MAX) const;
+  template <typename K> DenseCounter<K> &theDenseCounter(size_t) const;
 
   // virtual function for different
-  virtual void cv(const Genome &, vector<pair<int, CVmap>> &) = 0;
-  virtual void cv(const Gene &, vector<pair<int, CVmap>> &) = 0;
+  virtual set<int> lengths(const vector<size_t> &) const = 0;
+  virtual void cv(const GenomeArena &, vector<pair<int, CVvec>> &) = 0;
+  virtual void cv(const GeneView &, vector<pair<int, CVvec>> &) = 0;
+  virtual void cv(const Resample &, vector<pair<int, CVvec>> &) = 0;
 };
 
 // son class for Hao method
 struct HaoMethod : public CVmeth {
   HaoMethod() { kmin = 3; cvsuff = ".Hao"; };
-  void cv(const Genome &, vector<pair<int, CVmap>> &) override;
-  void cv(const Gene &, vector<pair<int, CVmap>> &) override;
-  void markov(const CVmap &, const CVmap &, const CVmap &, double, CVmap &);
+  set<int> lengths(const vector<size_t> &) const override;
+  void cv(const GenomeArena &, vector<pair<int, CVvec>> &) override;
+  void cv(const GeneView &, vector<pair<int, CVvec>> &) override;
+  void cv(const Resample &, vector<pair<int, CVvec>> &) override;
+
+  template <typename K, typename C>
+  void markov(const C &, const C &, const C &, size_t, double, KVec<K> &);
+  template <typename K>
+  void markov(const KVec<K> &, const KVec<K> &, const KVec<K> &, size_t,
+              double, KVec<K> &);
 
   template <typename T>
-  void docv(const T&, vector<pair<int, CVmap>> &);
+  void docv(const T &, size_t, vector<pair<int, CVvec>> &);
+  template <typename K, typename C, typename T>
+  void docv(const T &, vector<pair<int, CVvec>> &);
 };
 
 // son class for Li method
 struct Counting : public CVmeth {
-  Counting() { cvsuff = ".Count"; };
-  void cv(const Genome &, vector<pair<int, CVmap>> &) override;
-  void cv(const Gene &, vector<pair<int, CVmap>> &) override;
+  Counting() {
+    cvsuff = ".Count";
+    keepTail = true;
+  };
+  set<int> lengths(const vector<size_t> &) const override;
+  void cv(const GenomeArena &, vector<pair<int, CVvec>> &) override;
+  void cv(const GeneView &, vector<pair<int, CVvec>> &) override;
+  void cv(const Resample &, vector<pair<int, CVvec>> &) override;
+
+  template <typename T>
+  void docv(const T &, size_t, vector<pair<int, CVvec>> &);
 };
 
 #endif
\ No newline at end of file
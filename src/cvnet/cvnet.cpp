@@ -17,16 +17,18 @@ int main(int argc, char **argv) {
 
   // get cva
   net.gn2cva();
+  if (net.nboot > 0)
+    net.bootstrap();
   if (net.breakpoint.compare("cva") == 0)
     return 0;
 
-  // get sm matrix
-  net.cva2sm();
-  if (net.breakpoint.compare("sm") == 0)
-    return 0;
-
-  // get sparse matrix
-  net.sm2net();
+  // get sm matrix and sparse matrix for every k
+  for (auto k : net.fnm.klist) {
+    net.fnm.setk(k);
+    net.cva2sm();
+    if (net.breakpoint.compare("sm") != 0)
+      net.sm2net();
+  }
 }
 
 CVNet::CVNet(int argc, char *argv[]) {
@@ -60,10 +62,55 @@ CVNet::CVNet(int argc, char *argv[]) {
       .nargs(1)
       .store_into(fnm.cmeth);
   parser.add_argument("-k", "--kmer-length")
-      .help("cutoff for kmer length")
-      .default_value(fnm.k)
-      .store_into(fnm.k)
-      .nargs(1);
+      .help("kmer length, a list or range as 4,5,6 or 3-6")
+      .default_value(to_string(fnm.k))
+      .nargs(1)
+      .action([&](const auto &val) { fnm.setklist(val); });
+  parser.add_argument("--counter")
+      .help("engine to count kmers, auto/sort/hash")
+      .choices("auto", "sort", "hash")
+      .default_value(counter)
+      .nargs(1)
+      .store_into(counter);
+  parser.add_argument("--dense-max")
+      .help("maximal number of kmers for the dense counter in auto engine")
+      .default_value(denseMax)
+      .nargs(1)
+      .store_into(denseMax);
+  parser.add_argument("--cva-memory")
+      .help("memory budget (MB) for the CVA of a genome, 0 for no limit")
+      .default_value(cvaMemory)
+      .nargs(1)
+      .store_into(cvaMemory);
+  parser.add_argument("--cva-format")
+      .help("format of CVA file, v2 for mmap, pack for packed columns, gz for "
+            "the legacy one")
+      .choices("v2", "pack", "gz")
+      .default_value(cvaFormat)
+      .nargs(1)
+      .store_into(cvaFormat);
+  parser.add_argument("--cva-cache")
+      .help("memory budget (MB) for the CVAs cached in the similarity")
+      .default_value(cvaCache)
+      .nargs(1)
+      .store_into(cvaCache);
+  parser.add_argument("--simd")
+      .help("instruction set for the similarity kernels, "
+            "auto/avx512/avx2/scalar")
+      .choices("auto", "avx512", "avx2", "scalar")
+      .default_value(simd)
+      .nargs(1)
+      .store_into(simd);
+  parser.add_argument("--bootstrap")
+      .help("number of bootstrap replicates for the CV of genomes")
+      .default_value(nboot)
+      .nargs(1)
+      .store_into(nboot);
+  parser.add_argument("--seed")
+      .help("random seed for bootstrap")
+      .default_value(seed)
+      .nargs(1)
+      .store_into(seed);
   parser.add_argument("-s", "--similar-method")
       .help("method for similarity, "
             "Cosine/InterList/InterSet/Jaccard/Dice")
@@ -72,6 +119,12 @@ CVNet::CVNet(int argc, char *argv[]) {
       .default_value(fnm.smeth)
       .nargs(1)
       .store_into(fnm.smeth);
+  parser.add_argument("--max-df")
+      .help("maximal number of genes in a genome sharing a kstr, the kstrs in "
+            "more genes are skipped in similarity, 0 for no limit")
+      .default_value(fnm.maxdf)
+      .nargs(1)
+      .store_into(fnm.maxdf);
   parser.add_argument("-e", "--edge-method")
       .help("method for selecting edge, RBH/GRB/CUT/SRB")
       .choices("RBH", "GRB", "CUT", "SRB")
@@ -94,7 +147,7 @@ CVNet::CVNet(int argc, char *argv[]) {
       .nargs(1)
       .action([&](const auto &val) { fnm.setcache(val); });
   parser.add_argument("-o", "--outfile")
-      .help("output file name")
+      .help("output file name, $ in it is replaced by kmer length")
       .default_value(fnm.clsuf())
       .nargs(1)
       .store_into(fnm.outfn);
@@ -135,10 +188,16 @@ CVNet::CVNet(int argc, char *argv[]) {
     exit(1);
   }
 
+  // the packed CVAs are named apart
+  fnm.packed = cvaFormat.compare("pack") == 0;
+
   // check cutoff and mindist
   if (fnm.cutoff < fnm.mindist)
     fnm.cutoff = fnm.mindist;
 
+  // the slots of the dense counter are indexed by uint32
+  denseMax = min(denseMax, size_t(UINT32_MAX));
+
   // setup the input file names
   fnm.setfn();
 
@@ -155,41 +214,160 @@ CVNet::CVNet(int argc, char *argv[]) {
 
   // set cvmeth method
   cmeth = CVmeth::create(fnm.cmeth, fnm.cvdir, fnm.gtype);
+  cmeth->checkK(fnm.klist);
+  cmeth->gkey = fnm.gkey;
+  cmeth->setCounter(counter);
+  cmeth->denseMax = denseMax;
+  cmeth->cvaMemory = cvaMemory;
+  if (cvaFormat.compare("gz") == 0)
+    cmeth->cvaFormat = LEGACY;
+  else if (cvaFormat.compare("pack") == 0)
+    cmeth->cvaFormat = PACKED;
 
   // set select method
   smeth = SimilarMeth::create(fnm.smeth, fnm.mindist);
+  smeth->cache.budget = cvaCache << 20;
+  smeth->cache.maxdf = fnm.maxdf;
+  smeth->cache.genes = smeth->sparse;
+  theSimd.set(simd);
 
   // set select method
   emeth = EdgeMeth::create(fnm.emeth, fnm.cutoff);
 }
 
 void CVNet::gn2cva() {
+  // the genome larger than the share of a thread is done with its genes split
+  // into threads, and the others are done in parallel of genomes
+  long total(0);
+  for (auto &f : fnm.gflist)
+    total += max(getFileSize(f), 0L);
+  long share = total / omp_get_max_threads();
+  auto islarge = [&](const string &f) {
+    return omp_get_max_threads() > 1 && cmeth->cvaMemory == 0 &&
+           getFileSize(f) > share;
+  };
+
+  // the genomes not hashed yet are read once for their keys and CVAs, the
+  // slots of their keys are made before threads
+  if (!fnm.gnew.empty()) {
+    vector<string> hashes(fnm.gnew.size());
+    vector<size_t> large, small;
+    for (size_t j = 0; j < fnm.gnew.size(); ++j) {
+      cmeth->gkey[fnm.gnew[j]] = "";
+      if (islarge(fnm.gnew[j]))
+        large.emplace_back(j);
+      else
+        small.emplace_back(j);
+    }
+    string suf = fnm.hashkey("");
+    for (auto j : large)
+      hashes[j] = cmeth->hashcva(fnm.gnew[j], fnm.klist, suf, true);
+#pragma omp parallel for schedule(dynamic)
+    for (size_t j = 0; j < small.size(); ++j)
+      hashes[small[j]] = cmeth->hashcva(fnm.gnew[small[j]], fnm.klist, suf);
+    fnm.addgkey(hashes);
+  }
+
+  // the genomes with the same content share their cva, only one is done
+  vector<size_t> uniq;
+  set<string> cvset;
+  for (size_t i = 0; i < fnm.gflist.size(); ++i)
+    if (cvset.insert(cmeth->getCVname(fnm.gflist[i], fnm.k)).second)
+      uniq.emplace_back(i);
+
+  // derive the missing cva from the cached cva of a longer k if possible
+  vector<size_t> gsz(fnm.gflist.size(), 0);
+#pragma omp parallel for schedule(dynamic)
+  for (size_t j = 0; j < uniq.size(); ++j)
+    gsz[uniq[j]] = cmeth->derivecva(fnm.gflist[uniq[j]], fnm.klist);
+
+  // the genomes without cva of some k. The cva of all k are from one reading
+  // of genome. The genome streamed within the memory budget is read gene by
+  // gene, so all genomes are done in parallel of genomes
+  vector<size_t> large, small;
+  for (auto i : uniq) {
+    bool done(true);
+    for (auto k : fnm.klist)
+      done = done && cvavalid(cmeth->getCVname(fnm.gflist[i], k));
+    if (!done) {
+      if (islarge(fnm.gflist[i]))
+        large.emplace_back(i);
+      else
+        small.emplace_back(i);
+    }
+  }
+
   //  get the cva for every species
+  for (auto i : large)
+    gsz[i] = cmeth->getcva(fnm.gflist[i], fnm.klist, true);
+#pragma omp parallel for schedule(dynamic)
+  for (size_t j = 0; j < small.size(); ++j)
+    gsz[small[j]] = cmeth->getcva(fnm.gflist[small[j]], fnm.klist);
+
+  // the number of genes in the cva cached by other genomes or projects
   map<string, size_t> gsize;
-  for (auto &f : fnm.gflist)
-    gsize[getFileName(f)] = 0;
-#pragma omp parallel for
   for (size_t i = 0; i < fnm.gflist.size(); ++i) {
-    if (!gzvalid(cmeth->getCVname(fnm.gflist[i], fnm.k))) {
-      size_t gsz = cmeth->getcva(fnm.gflist[i], fnm.k);
-      gsize[getFileName(fnm.gflist[i])] = gsz;
-    }
+    if (gsz[i] == 0)
+      gsz[i] = CVAinfo(cmeth->getCVname(fnm.gflist[i], fnm.k)).nCV;
+    gsize[fnm.keyname(fnm.gflist[i])] = gsz[i];
   }
   fnm.updateGeneSizeFile(gsize);
   theInfo("Get all CVAs for Genomes");
 }
 
+void CVNet::bootstrap() {
+  // the directories of replicates
+  vector<string> btdirs;
+  for (size_t r = 1; r <= nboot; ++r) {
+    btdirs.emplace_back(fnm.cvdir + "boot/" + to_string(r) + "/");
+    mkpath(btdirs.back());
+  }
+
+  // the replicates of every genome are in parallel
+  for (auto &f : fnm.gflist)
+    cmeth->bootstrap(f, fnm.klist, btdirs, seed);
+  theInfo("Get bootstrap CVs for Genomes");
+}
+
 void CVNet::cva2sm() {
-  // Calculate the similar matrix
+  // the missing similar matrices, in tiles of genome pairs so that the
+  // cached CVAs are reused by the nearby pairs
   vector<TriFileName> tlist;
-  fnm.trifnlist(tlist);
-#pragma omp parallel for
-  for (int i = 0; i < tlist.size(); ++i) {
-    auto &it = tlist[i];
-    if (!gzvalid(it.smf))
-      smeth->getMatrix(it);
+  fnm.smtodo(tlist);
+  tileOrder(tlist);
+
+  // the dictionary of kstrs in the genomes for the shared kstrs of pairs. It
+  // is kept in the cache by all CVAs of the project, so it is built once for
+  // the genomes and shared by the runs of the other methods of similarity
+  KDict dict;
+  if (!tlist.empty()) {
+    vector<string> cvlist;
+    fnm.cvfnlist(cvlist);
+    sort(cvlist.begin(), cvlist.end());
+    cvlist.erase(unique(cvlist.begin(), cvlist.end()), cvlist.end());
+    string dfile = fnm.dictfn(cvlist);
+    mkpath(dfile.substr(0, dfile.find_last_of('/') + 1));
+    FileLock lock(dfile);
+    if (!dict.read(dfile, cvlist)) {
+      dict.build(dfile, cvlist);
+      dict.read(dfile, cvlist);
+    }
+    if (dict.size() > 0)
+      smeth->cache.dict = &dict;
   }
-  theInfo("Get All Similar Matrix");
+
+  // Calculate the similar matrix
+#pragma omp parallel for
+  for (int i = 0; i < tlist.size(); ++i)
+    smeth->getMatrix(tlist[i]);
+  theInfo("Get All Similar Matrix for K=" + to_string(fnm.k) + ", " +
+          smeth->cache.info() + ", SIMD kernel: " + theSimd.name());
+  if (fnm.maxdf > 0)
+    theInfo("In the similarity for K=" + to_string(fnm.k) + ", " +
+            smeth->skipInfo());
+  smeth->skipKstr = smeth->skipAdd = 0;
+  smeth->cache.clear();
+  smeth->cache.dict = nullptr;
 }
 
 void CVNet::sm2net() {
@@ -199,8 +377,8 @@ void CVNet::sm2net() {
   map<string, size_t> gidx;
   size_t ngene = fnm.obtainGeneIndex(gidx);
   // get similar matrix filename
-  vector<string> smlist;
-  fnm.smfnlist(smlist);
+  vector<TriFileName> smlist;
+  fnm.trifnlist(smlist);
   // get net
   if (fnm.outfmt.compare("mcl") == 0) {
     MclMatrix mm(ngene, emeth->directed);
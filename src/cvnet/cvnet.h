@@ -15,6 +15,7 @@
 
 #include <argparse/argparse.hpp>
 #include <iostream>
+#include <omp.h>
 #include <vector>
 
 #include "cvmeth.h"
@@ -31,9 +32,18 @@ struct CVNet {
   EdgeMeth *emeth;
   FileOption fnm;
   string breakpoint = "None";
+  string counter = "auto";
+  size_t denseMax = 1UL << 23;
+  size_t cvaMemory = 0;
+  string cvaFormat = "v2";
+  size_t cvaCache = 1024;
+  string simd = "auto";
+  size_t nboot = 0;
+  size_t seed = 1;
 
   CVNet(int argc, char **argv);
   void gn2cva();
+  void bootstrap();
   void cva2sm();
   void sm2net();
 };
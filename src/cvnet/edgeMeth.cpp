@@ -34,14 +34,16 @@ EdgeMeth *EdgeMeth::create(const string &methStr, double cutoff) {
   return meth;
 };
 
+// the genomes of the matrix are by the pair, since the matrix in cache is
+// named by the hash of genomes and may be shared by genomes of other names
 pair<size_t, size_t> EdgeMeth::getIndex(const map<string, size_t> &gidx,
-                                        const MatrixHeader &hd) const {
-  auto itrow = gidx.find(delsuffix(hd.rowName));
-  auto itcol = gidx.find(delsuffix(hd.colName));
+                                        const TriFileName &tf) const {
+  auto itrow = gidx.find(tf.gna);
+  auto itcol = gidx.find(tf.gnb);
   if (itrow == gidx.end())
-    throw runtime_error("Row not found in GIdx: " + delsuffix(hd.rowName));
+    throw runtime_error("Row not found in GIdx: " + tf.gna);
   if (itcol == gidx.end())
-    throw runtime_error("Col not found in GIdx: " + delsuffix(hd.colName));
+    throw runtime_error("Col not found in GIdx: " + tf.gnb);
   return make_pair(itrow->second, itcol->second);
 };
 
@@ -62,18 +64,19 @@ void EdgeMeth::shiftEdges(const pair<size_t, size_t> &mshift,
 /*****************************************************************************
  ********* The Derived Classes
  *****************************************************************************/
-void EdgeByCutoff::sm2edge(const string &fsm, const map<string, size_t> &gidx,
+void EdgeByCutoff::sm2edge(const TriFileName &tf,
+                           const map<string, size_t> &gidx,
                            vector<Edge> &es) const {
-  Msimilar sm(fsm);
+  Msimilar sm(tf.smfile(), tf.trans);
   cutoff(sm, threshold, es);
-  shiftEdges(getIndex(gidx, sm.header), es);
+  shiftEdges(getIndex(gidx, tf), es);
 }
 
-void EdgeByMutualBest::sm2edge(const string &fsm,
+void EdgeByMutualBest::sm2edge(const TriFileName &tf,
                                const map<string, size_t> &gidx,
                                vector<Edge> &es) const {
-  GeneRBH rbh(fsm);
-  auto mshift = getIndex(gidx, rbh.header);
+  GeneRBH rbh(tf.smfile(), tf.trans);
+  auto mshift = getIndex(gidx, tf);
   for(auto& it : rbh.data){
     if(it.weight > threshold){
       it.shift(mshift);
@@ -82,26 +85,26 @@ void EdgeByMutualBest::sm2edge(const string &fsm,
   }
 }
 
-void EdgeByMutualBestPlus::sm2edge(const string &fsm,
+void EdgeByMutualBestPlus::sm2edge(const TriFileName &tf,
                                    const map<string, size_t> &gidx,
                                    vector<Edge> &es) const {
   // get the minial rbh between two genome
-  GeneRBH rbh(fsm);
+  GeneRBH rbh(tf.smfile(), tf.trans);
   float minW = std::numeric_limits<float>::max();
   for (auto &it : rbh.data)
     minW = it.weight < minW ? it.weight : minW;
   minW = minW < threshold ? threshold : minW;
 
   // get the edge and shift
-  Msimilar sm(fsm);
+  Msimilar sm(tf.smfile(), tf.trans);
   cutoff(sm, minW, es);
-  shiftEdges(getIndex(gidx, sm.header), es);
+  shiftEdges(getIndex(gidx, tf), es);
 };
 
-void EdgeByGeneMutualBest::init(const vector<string> &flist,
+void EdgeByGeneMutualBest::init(const vector<TriFileName> &flist,
                                 const map<string, size_t> &gidx, size_t ngene) {
   // initial the minGRB
-  minGRB.resize(ngene, std::numeric_limits<float>::max());
+  minGRB.assign(ngene, std::numeric_limits<float>::max());
 
   // update the minGRB by RBH
 #pragma omp parallel
@@ -109,8 +112,8 @@ void EdgeByGeneMutualBest::init(const vector<string> &flist,
     vector<float> grb(ngene, std::numeric_limits<float>::max());
 #pragma omp for
     for (auto i = 0; i < flist.size(); ++i) {
-      GeneRBH rbh(flist[i]);
-      auto mshift = getIndex(gidx, rbh.header);
+      GeneRBH rbh(flist[i].smfile(), flist[i].trans);
+      auto mshift = getIndex(gidx, flist[i]);
       for (auto it : rbh.data) {
         auto irow = mshift.first + it.index.first;
         auto icol = mshift.second + it.index.second;
@@ -135,13 +138,13 @@ void EdgeByGeneMutualBest::init(const vector<string> &flist,
   }
 };
 
-void EdgeByGeneMutualBest::sm2edge(const string &fsm,
+void EdgeByGeneMutualBest::sm2edge(const TriFileName &tf,
                                    const map<string, size_t> &gidx,
                                    vector<Edge> &es) const {
 
   // read the similar matrix
-  Msimilar sm(fsm);
-  auto mshift = getIndex(gidx, sm.header);
+  Msimilar sm(tf.smfile(), tf.trans);
+  auto mshift = getIndex(gidx, tf);
 
   // get mininal RBH for gene
   for (auto i = 0; i < sm.header.nrow; ++i) {
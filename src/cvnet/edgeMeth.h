@@ -17,6 +17,7 @@
 #include <atomic>
 
 #include "edges.h"
+#include "fileOption.h"
 #include "mclmatrix.h"
 #include "similarMatrix.h"
 
@@ -31,8 +32,8 @@ struct EdgeMeth {
 
   // get the full net
   template <typename T>
-  void getNet(const vector<string> &flist, const map<string, size_t> &gidx,
-              size_t ngene, T &net) {
+  void getNet(const vector<TriFileName> &flist,
+              const map<string, size_t> &gidx, size_t ngene, T &net) {
     // initial network method
     init(flist, gidx, ngene);
     theInfo("The net method: " + methStr + " is ready");
@@ -50,29 +51,29 @@ struct EdgeMeth {
 
   // select items: cutoff or Reciprocal Best Hit
   pair<size_t, size_t> getIndex(const map<string, size_t> &,
-                                const MatrixHeader &) const;
+                                const TriFileName &) const;
   void cutoff(const Msimilar &, float, vector<Edge> &) const;
   void shiftEdges(const pair<size_t, size_t> &, vector<Edge> &) const;
 
   // method in derived classes
-  virtual void init(const vector<string> &flist,
+  virtual void init(const vector<TriFileName> &flist,
                     const map<string, size_t> &gidx, size_t ngene){};
-  virtual void sm2edge(const string &, const map<string, size_t> &,
+  virtual void sm2edge(const TriFileName &, const map<string, size_t> &,
                        vector<Edge> &) const = 0;
 };
 
 struct EdgeByCutoff : public EdgeMeth {
-  void sm2edge(const string &, const map<string, size_t> &,
+  void sm2edge(const TriFileName &, const map<string, size_t> &,
                vector<Edge> &) const override;
 };
 
 struct EdgeByMutualBest : public EdgeMeth {
-  void sm2edge(const string &, const map<string, size_t> &,
+  void sm2edge(const TriFileName &, const map<string, size_t> &,
                vector<Edge> &) const override;
 };
 
 struct EdgeByMutualBestPlus : public EdgeMeth {
-  void sm2edge(const string &, const map<string, size_t> &,
+  void sm2edge(const TriFileName &, const map<string, size_t> &,
                vector<Edge> &) const override;
 };
 
@@ -80,9 +81,9 @@ struct EdgeByGeneMutualBest : public EdgeMeth {
   vector<float> minGRB;
   EdgeByGeneMutualBest() { directed = true; };
 
-  void init(const vector<string> &, const map<string, size_t> &,
+  void init(const vector<TriFileName> &, const map<string, size_t> &,
             size_t) override;
-  void sm2edge(const string &, const map<string, size_t> &,
+  void sm2edge(const TriFileName &, const map<string, size_t> &,
                vector<Edge> &) const override;
 };
 
@@ -70,10 +70,13 @@ GeneRBH::GeneRBH(const Msimilar &sm) : header(sm.header) {
   }
 }
 
-void GeneRBH::write(const string &fsm) const {
+// the RBH of the transposed matrix is kept with the matrix in the .rbt file.
+// The best hits are picked by their order in rows, so they are computed for
+// every orientation of matrix
+void GeneRBH::write(const string &fsm, bool trans) const {
   // open and test file
   gzFile fp;
-  string gzfile = addsuffix(fsm, ".rbh.gz");
+  string gzfile = addsuffix(fsm, trans ? ".rbt.gz" : ".rbh.gz");
   if ((fp = gzopen(gzfile.c_str(), "wb")) == NULL)
     throw runtime_error("Cannot open file for reading: " + gzfile);
 
@@ -89,10 +92,10 @@ void GeneRBH::write(const string &fsm) const {
   gzclose(fp);
 };
 
-void GeneRBH::read(const string &fsm) {
+void GeneRBH::read(const string &fsm, bool trans) {
   // open and test file
   gzFile fp;
-  string gzfile = addsuffix(fsm, ".rbh.gz");
+  string gzfile = addsuffix(fsm, trans ? ".rbt.gz" : ".rbh.gz");
   if ((fp = gzopen(gzfile.c_str(), "rb")) == NULL)
     throw runtime_error("Cannot open file for reading: " + gzfile);
 
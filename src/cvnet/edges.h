@@ -51,10 +51,11 @@ struct GeneRBH : public EdgeList {
   MatrixHeader header;
 
   GeneRBH(const Msimilar &);
-  GeneRBH(const string &fsm) { read(fsm); };
+  GeneRBH(const MatrixHeader &hd) : header(hd){};
+  GeneRBH(const string &fsm, bool trans = false) { read(fsm, trans); };
 
-  void write(const string &) const;
-  void read(const string &);
+  void write(const string &, bool trans = false) const;
+  void read(const string &, bool trans = false);
 
   friend ostream &operator<<(ostream &, const GeneRBH&);
 };
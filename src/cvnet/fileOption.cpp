@@ -35,9 +35,9 @@ void FileOption::setfn() {
   readlist(lstfn, flist);
   uniqueWithOrder(flist);
   setfn(flist);
-
   if (!netsuf.empty())
     setpair(netsuf);
+  setgkey();
 };
 
 void FileOption::setfn(const vector<TriFileName> &trilist) {
@@ -80,21 +80,102 @@ void FileOption::setpair(const string &fname) {
   }
   infile.close();
 
-  // setup trifilelist
-  _genTriFNList(pairs);
-
   // reset the gflist
   vector<string> flist;
+  map<size_t, size_t> nIndexs;
   for (auto &ndx : gIndexs) {
+    nIndexs[ndx] = flist.size();
     flist.emplace_back(gflist[ndx]);
   }
   gflist.swap(flist);
+
+  // the pairs in the new gflist, the trifilelist is set up by them when the
+  // genomes are hashed, see setgkey
+  for (auto &pr : pairs)
+    gpairs.emplace_back(nIndexs[pr.first], nIndexs[pr.second]);
+};
+
+/* the cache files of a genome are named by the hash of its sequences with
+ * the genome type, so the genome renamed or shared by projects is computed
+ * once, and the genome changed is computed again. The hashes are indexed
+ * by the real path, size and modified time of genome files. The genomes not
+ * indexed are left in gnew, and hashed in the same reading for their CVAs */
+void FileOption::setgkey() {
+  map<string, tuple<long, long, string>> index;
+  readGenomeHash(index);
+  for (auto &f : gflist) {
+    long fsize = getFileSize(f);
+    if (fsize < 0)
+      continue;
+    auto it = index.find(getRealPath(f));
+    if (it != index.end() && get<0>(it->second) == fsize &&
+        get<1>(it->second) == getFileMTime(f))
+      gkey[f] = get<2>(it->second) + sufsep + gtype;
+    else
+      gnew.emplace_back(f);
+  }
+};
+
+// the key of a genome in the cache by its hash
+string FileOption::hashkey(const string &hash) const {
+  return hash + sufsep + gtype;
+};
+
+// set the keys of the genomes in gnew by their hashes
+void FileOption::addgkey(const vector<string> &hashes) {
+  if (gnew.empty())
+    return;
+  map<string, tuple<long, long, string>> hashed;
+  for (size_t j = 0; j < gnew.size(); ++j) {
+    const string &f = gnew[j];
+    hashed[getRealPath(f)] =
+        make_tuple(getFileSize(f), getFileMTime(f), hashes[j]);
+    gkey[f] = hashkey(hashes[j]);
+  }
+
+  // the index is shared by projects, so the new hashes are merged into the
+  // one on disk under the lock, and it is replaced as a whole
+  mkpath(ghfn.substr(0, ghfn.find_last_of('/') + 1));
+  FileLock lock(ghfn);
+  map<string, tuple<long, long, string>> index;
+  readGenomeHash(index);
+  for (auto &it : hashed)
+    index[it.first] = it.second;
+  string tfile = tmpName(ghfn);
+  ofstream oghs(tfile);
+  for (auto &it : index)
+    oghs << it.first << "\t" << get<0>(it.second) << "\t" << get<1>(it.second)
+         << "\t" << get<2>(it.second) << "\n";
+  oghs.close();
+  if (!oghs) {
+    cerr << "Error happen on write file: " << ghfn << endl;
+    exit(1);
+  }
+  renameTo(tfile, ghfn);
+  theInfo("Hashed " + to_string(gnew.size()) + " genomes for the cache");
+  gnew.clear();
+};
+
+void FileOption::readGenomeHash(map<string, tuple<long, long, string>> &index) {
+  string path, hash;
+  long fsize, mtime;
+  ifstream ighs(ghfn);
+  while (ighs >> path >> fsize >> mtime >> hash)
+    index[path] = make_tuple(fsize, mtime, hash);
+  ighs.close();
+};
+
+// the name of the cache files of a genome, the file name without its hash
+string FileOption::keyname(const string &fname) const {
+  auto it = gkey.find(fname);
+  return it == gkey.end() ? getFileName(fname) : it->second;
 };
 
 size_t FileOption::cvfnlist(vector<string> &cvlist) {
   string suff = cvsuf();
   for (auto &nm : gflist)
-    cvlist.emplace_back(setFilePath(cvdir, suff, nm));
+    cvlist.emplace_back(
+        setFilePath(cvdir, suff, cvdir.empty() ? nm : keyname(nm)));
   return cvlist.size();
 };
 
@@ -114,6 +195,32 @@ size_t FileOption::trifnlist(vector<TriFileName> &trilist) {
   return trilist.size();
 };
 
+/* the pairs served by the cached matrix with the threshold not above the
+ * mindist, in the same or transposed orientation. The pairs left are to be
+ * computed, and their matrices shared by pairs are computed once */
+size_t FileOption::smtodo(vector<TriFileName> &todo) {
+  if (smplist.empty())
+    _genTriFNList();
+  mkpath(smdir);
+
+  // the threshold is saved as float, so it is compared with the float mindist
+  auto serve = [this](const string &fsm, const string &rbh) {
+    return gzvalid(fsm) && gzvalid(addsuffix(fsm, rbh)) &&
+           MatrixHeader(fsm).threshold <= float(mindist);
+  };
+  set<string> smset;
+  for (auto &it : smplist) {
+    it.trans = false;
+    if (serve(it.smf, ".rbh.gz"))
+      continue;
+    if (serve(it.smt, ".rbt.gz"))
+      it.trans = true;
+    else if (smset.insert(it.smf).second)
+      todo.emplace_back(it);
+  }
+  return todo.size();
+};
+
 size_t FileOption::geneIndexBySMFile(map<string, size_t> &offset) {
   if (smplist.empty())
     _genTriFNList();
@@ -148,7 +255,8 @@ size_t FileOption::geneIndexByCVFile(map<string, size_t> &offset) {
   return ndx;
 };
 
-size_t FileOption::readGeneIndex(map<string, size_t> &gShift) {
+size_t FileOption::readGeneIndex(map<string, size_t> &gShift,
+                                 map<string, size_t> &gSize) {
   string line;
   size_t start;
   size_t size;
@@ -162,6 +270,7 @@ size_t FileOption::readGeneIndex(map<string, size_t> &gShift) {
     stringstream ss(line);
     ss >> genome >> start >> size;
     gShift[genome] = start;
+    gSize[genome] = size;
   }
   igi.close();
   return start + size;
@@ -170,11 +279,7 @@ size_t FileOption::readGeneIndex(map<string, size_t> &gShift) {
 size_t FileOption::genGeneIndex(map<string, size_t> &gShift) {
   // read cache files
   map<string, size_t> gsize;
-  pair<string, size_t> gsz;
-  ifstream igs(gszfn);
-  while (igs >> gsz.first >> gsz.second)
-    gsize.insert(gsz);
-  igs.close();
+  readGeneSize(gsize);
 
   // obtained gene index from gene size map
   size_t ndx = 0;
@@ -183,9 +288,10 @@ size_t FileOption::genGeneIndex(map<string, size_t> &gShift) {
   fndx << "Genome\tStart\tSize\n";
   for (const auto &fn : gflist) {
     string gn = getFileName(fn);
+    size_t sz = gsize[keyname(fn)];
     gShift[gn] = ndx;
-    fndx << gn << "\t" << ndx << "\t" << gsize[gn] << "\n";
-    ndx += gsize[gn];
+    fndx << gn << "\t" << ndx << "\t" << sz << "\n";
+    ndx += sz;
   }
   fndx.close();
 
@@ -196,12 +302,14 @@ size_t FileOption::genGeneIndex(map<string, size_t> &gShift) {
 size_t FileOption::obtainGeneIndex(map<string, size_t> &gShift) {
   if (fileExists(outndx)) {
     // read gene index
-    size_t ngene = readGeneIndex(gShift);
+    map<string, size_t> isize, gsize;
+    size_t ngene = readGeneIndex(gShift, isize);
+    readGeneSize(gsize);
 
-    // check gene list
+    // check gene list, and the sizes of genomes changed
     for (const auto &fn : gflist) {
       string gn = getFileName(fn);
-      if (gShift.find(gn) == gShift.end())
+      if (gShift.find(gn) == gShift.end() || isize[gn] != gsize[keyname(fn)])
         return genGeneIndex(gShift);
     }
     theInfo("Used existing gene index file");
@@ -212,8 +320,20 @@ size_t FileOption::obtainGeneIndex(map<string, size_t> &gShift) {
   return genGeneIndex(gShift);
 };
 
+void FileOption::readGeneSize(map<string, size_t> &gsize) {
+  pair<string, size_t> gsz;
+  ifstream igs(gszfn);
+  while (igs >> gsz.first >> gsz.second)
+    gsize.insert(gsz);
+  igs.close();
+};
+
+// the gene sizes are keyed by the cache names of genomes as the CVAs, and
+// the file is shared by projects as GenomeHash.tsv
 void FileOption::updateGeneSizeFile(map<string, size_t> &gsize) {
   // read old gene size file into gene size map
+  mkpath(gszfn.substr(0, gszfn.find_last_of('/') + 1));
+  FileLock lock(gszfn);
   string gn;
   size_t sz;
   ifstream igs(gszfn);
@@ -225,14 +345,54 @@ void FileOption::updateGeneSizeFile(map<string, size_t> &gsize) {
   igs.close();
 
   // update gene size file with new genome sizes
-  ofstream ogs(gszfn);
+  string tfile = tmpName(gszfn);
+  ofstream ogs(tfile);
   for (auto &it : gsize)
     ogs << it.first << "\t" << it.second << "\n";
   ogs.close();
+  if (!ogs) {
+    cerr << "Error happen on write file: " << gszfn << endl;
+    exit(1);
+  }
+  renameTo(tfile, gszfn);
+};
+
+string FileOption::cvsuf() {
+  // the packed CVAs may be quantized, they and their matrices are apart from
+  // the exact ones
+  string suf = sufsep + cmeth + to_string(k);
+  if (packed)
+    suf += sufsep + "pack";
+  return suf;
+};
+string FileOption::smsuf() {
+  // the matrices with the kstrs capped are apart from the full ones, and the
+  // Euclidean ones by the inner product are apart from the older ones by d^2
+  string suf = cvsuf() + sufsep + smeth;
+  if (smeth == "Euclidean")
+    suf += "2";
+  if (maxdf > 0)
+    suf += sufsep + "df" + to_string(maxdf);
+  return suf;
+};
+// the dictionary of kstrs by the FNV-1a hash of the names of its CVAs
+string FileOption::dictfn(const vector<string> &cvlist) {
+  vector<string> names;
+  for (auto &cv : cvlist)
+    names.emplace_back(getFileName(cv));
+  sort(names.begin(), names.end());
+  uint64_t h(0xCBF29CE484222325UL);
+  for (auto &nm : names) {
+    for (auto c : nm + "\n") {
+      h ^= uint8_t(c);
+      h *= 0x100000001B3UL;
+    }
+  }
+  ostringstream os;
+  os << hex << setw(16) << setfill('0') << h;
+  return cvdir + "dict/" + os.str() + cvsuf() + ".dict";
 };
 
-string FileOption::cvsuf() { return sufsep + cmeth + to_string(k); };
-string FileOption::smsuf() { return cvsuf() + sufsep + smeth; };
 string FileOption::clsuf() {
   ostringstream oss;
   oss << gtype << smsuf() << sufsep << emeth << setw(2) << setfill('0')
@@ -241,17 +401,75 @@ string FileOption::clsuf() {
 }
 
 void FileOption::setoutfn(bool reset) {
+  // the output file name given, the $ in it is replaced by k
+  if (reset) {
+    outpat = outdir + outfn;
+    if (klist.size() > 1 && outpat.find('$') == string::npos)
+      outpat += sufsep + "$";
+  }
+  _setOutFN();
+
+  // index file path
+  if (!netsuf.empty())
+    outndx += sufsep + netsuf;
+  outndx = outdir + outndx;
+}
+
+void FileOption::_setOutFN() {
   // add suffix for net method
   string addsuf;
   if (!netsuf.empty())
     addsuf = sufsep + netsuf;
   // output file path
-  if (reset)
-    outfn = outdir + outfn;
-  else
+  if (outpat.empty())
     outfn = outdir + clsuf() + addsuf + "." + outfmt;
-  // index file path
-  outndx = outdir + outndx + addsuf;
+  else
+    outfn = nameWithK(outpat, k);
+}
+
+// the k list in the form of 5, 4,5,6, 3-6 or their mixture
+void FileOption::setklist(const string &str) {
+  set<size_t> kset;
+  vector<string> wd;
+  separateWord(wd, str, ",");
+  for (auto &w : wd) {
+    auto pos = w.find('-');
+    int kb = str2int(w.substr(0, pos));
+    int ke = pos == string::npos ? kb : str2int(w.substr(pos + 1));
+    if (kb <= 0 || ke < kb) {
+      cerr << "Invalid kmer length: " << w << endl;
+      exit(3);
+    }
+    for (int i = kb; i <= ke; ++i)
+      kset.insert(i);
+  }
+  if (kset.empty()) {
+    cerr << "No kmer length in: " << str << endl;
+    exit(3);
+  }
+  klist.assign(kset.begin(), kset.end());
+  k = klist.front();
+}
+
+// switch to another k, the names of cv and sm files are renamed
+void FileOption::setk(size_t nk) {
+  string ocv = cvsuf();
+  string osm = smsuf();
+  k = nk;
+  string ncv = cvsuf();
+  string nsm = smsuf();
+  auto resuf = [](string &str, const string &osuf, const string &nsuf) {
+    if (str.length() >= osuf.length() &&
+        str.compare(str.length() - osuf.length(), osuf.length(), osuf) == 0)
+      str.replace(str.length() - osuf.length(), osuf.length(), nsuf);
+  };
+  for (auto &it : smplist) {
+    resuf(it.cvfa, ocv, ncv);
+    resuf(it.cvfb, ocv, ncv);
+    resuf(it.smf, osm, nsm);
+    resuf(it.smt, osm, nsm);
+  }
+  _setOutFN();
 }
 
 void FileOption::setSuffix(const string &str) {
@@ -286,6 +504,7 @@ void FileOption::setcache(string dir) {
   cvdir = cvdir.replace(0, 5, dir);
   smdir = smdir.replace(0, 5, dir);
   gszfn = gszfn.replace(0, 5, dir);
+  ghfn = ghfn.replace(0, 5, dir);
 };
 
 void FileOption::setoutdir(const string &dir) {
@@ -298,9 +517,13 @@ void FileOption::setoutdir(const string &dir) {
 string FileOption::info() const {
   string str;
   str +=
-      "Method for Composition Vector: " + cmeth + ", with Kmer=" + to_string(k);
+      "Method for Composition Vector: " + cmeth + ", with Kmer=";
+  for (size_t i = 0; i < klist.size(); ++i)
+    str += (i == 0 ? "" : ",") + to_string(klist[i]);
   str += "\nMethod for Similarity between CV: " + smeth + ", save ";
   str += mindist < 0 ? "Full Matrix" : "Similarity >= " + to_string(mindist);
+  if (maxdf > 0)
+    str += ", skip kstrs in more than " + to_string(maxdf) + " genes";
   str += "\nMethod for Selecting Edge: " + emeth +
          ", with Cutoff = " + to_string(cutoff);
   str += "\nInput List file: " + lstfn;
@@ -308,7 +531,7 @@ string FileOption::info() const {
     str += "\nWith pairs file: " + netsuf;
   size_t nNode = gflist.size();
   float degree =
-      smplist.empty() ? nNode - 1 : float(smplist.size()) * 2.0 / nNode;
+      gpairs.empty() ? nNode - 1 : float(gpairs.size()) * 2.0 / nNode;
   str += "\nNumber of Genomes: " + to_string(nNode) +
          ", with Average Degree=" + to_string(degree);
   str += "\nOutput graph file: " + outfn;
@@ -318,6 +541,8 @@ string FileOption::info() const {
 };
 
 void FileOption::_genTriFNList() {
+  if (!gpairs.empty())
+    return _genTriFNList(gpairs);
   vector<pair<size_t, size_t>> pairs;
   for (auto i = 0; i < gflist.size(); i++) {
     for (auto j = i + 1; j < gflist.size(); j++) {
@@ -333,12 +558,15 @@ void FileOption::_genTriFNList(const vector<pair<size_t, size_t>> &pairs) {
   cvfnlist(cvlist);
   for (const auto &pr : pairs) {
     smplist.emplace_back(cvlist[pr.first], cvlist[pr.second],
-                         _smFN(gflist[pr.first], gflist[pr.second]));
+                         _smFN(gflist[pr.first], gflist[pr.second]),
+                         getFileName(gflist[pr.first]),
+                         getFileName(gflist[pr.second]));
+    smplist.back().smt = _smFN(gflist[pr.second], gflist[pr.first]);
   }
 };
 
 string FileOption::_smFN(const string &astr, const string &bstr) {
-  return smdir + getFileName(astr) + "-" + getFileName(bstr) + smsuf();
+  return smdir + keyname(astr) + "-" + keyname(bstr) + smsuf();
 };
 
 string setFilePath(const string &supdir, const string &suffix,
@@ -354,4 +582,33 @@ string setFilePath(const string &supdir, const string &suffix,
     nstr = supdir + getFileName(nstr);
 
   return nstr;
-};
\ No newline at end of file
+};
+// sort the pairs by the Z-order of the indices of their genomes, then the
+// pairs near in the list share their genomes at all scales of tiles
+void tileOrder(vector<TriFileName> &trilist) {
+  unordered_map<string, uint32_t> gid;
+  for (auto &tf : trilist) {
+    gid.emplace(tf.cvfa, gid.size());
+    gid.emplace(tf.cvfb, gid.size());
+  }
+  auto spread = [](uint64_t x) {
+    x = (x | (x << 16)) & 0x0000FFFF0000FFFFUL;
+    x = (x | (x << 8)) & 0x00FF00FF00FF00FFUL;
+    x = (x | (x << 4)) & 0x0F0F0F0F0F0F0F0FUL;
+    x = (x | (x << 2)) & 0x3333333333333333UL;
+    x = (x | (x << 1)) & 0x5555555555555555UL;
+    return x;
+  };
+  vector<pair<uint64_t, size_t>> key;
+  for (size_t i = 0; i < trilist.size(); ++i)
+    key.emplace_back((spread(gid[trilist[i].cvfa]) << 1) |
+                         spread(gid[trilist[i].cvfb]),
+                     i);
+  sort(key.begin(), key.end());
+
+  vector<TriFileName> tlist;
+  tlist.reserve(trilist.size());
+  for (auto &it : key)
+    tlist.emplace_back(move(trilist[it.second]));
+  trilist.swap(tlist);
+};
@@ -15,10 +15,14 @@
 
 #include <algorithm>
 #include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <map>
 #include <regex>
 #include <set>
 #include <string>
+#include <tuple>
+#include <unordered_map>
 #include <vector>
 
 #include "cvarray.h"
@@ -26,13 +30,22 @@
 #include "similarMatrix.h"
 using namespace std;
 
+// the similar matrix of the pair is in smf, or in smt of the transposed pair
+// if the flag trans is set
 struct TriFileName {
   string cvfa, cvfb, smf;
+  string gna, gnb;
+  string smt;
+  bool trans = false;
 
   TriFileName() = default;
   TriFileName(const string &a, const string &b, const string &o)
       : cvfa(a), cvfb(b), smf(o){};
+  TriFileName(const string &a, const string &b, const string &o,
+              const string &ga, const string &gb)
+      : cvfa(a), cvfb(b), smf(o), gna(ga), gnb(gb){};
 
+  const string &smfile() const { return trans ? smt : smf; };
   friend ostream &operator<<(ostream &, const TriFileName &);
 };
 
@@ -43,11 +56,15 @@ struct FileOption {
   string gtype = "faa";
   string cvdir = "cache/cva/";
   string gszfn = "cache/GenomeSize.tsv";
+  string ghfn = "cache/GenomeHash.tsv";
   string cmeth = "Count";
   int k = 5;
+  vector<size_t> klist{5};
   string smeth = "InterList";
   string smdir = "cache/sm/";
   double mindist = -0.1;
+  size_t maxdf = 0;
+  bool packed = false;
   string emeth = "GRB"; 
   double cutoff = 0.1;
   string outdir = "mcl/";
@@ -55,8 +72,12 @@ struct FileOption {
   string outfmt = "mcl";
   string netsuf;
   string outfn;
+  string outpat;
 
   vector<string> gflist;
+  map<string, string> gkey;
+  vector<string> gnew;
+  vector<pair<size_t, size_t>> gpairs;
   vector<TriFileName> smplist;
 
   FileOption() = default;
@@ -65,25 +86,35 @@ struct FileOption {
   void setfn(const vector<string> &);
   void setfn(const vector<TriFileName> &);
   void setpair(const string&);
+  void setgkey();
+  string hashkey(const string &) const;
+  void addgkey(const vector<string> &);
+  void readGenomeHash(map<string, tuple<long, long, string>> &);
+  string keyname(const string &) const;
 
   void setSuffix(const string &);
   void setgndir(const string &);
   void setcache(string);
   void setoutdir(const string &);
   void setoutfn(bool reset=false);
+  void setklist(const string &);
+  void setk(size_t);
 
   string cvsuf();
   string smsuf();
   string clsuf();
+  string dictfn(const vector<string> &);
 
   size_t cvfnlist(vector<string> &);
   size_t smfnlist(vector<string> &);
   size_t trifnlist(vector<TriFileName> &);
+  size_t smtodo(vector<TriFileName> &);
 
   size_t geneIndexByCVFile(map<string, size_t> &);
   size_t geneIndexBySMFile(map<string, size_t> &);
   size_t obtainGeneIndex(map<string, size_t> &);
-  size_t readGeneIndex(map<string, size_t> &);
+  size_t readGeneIndex(map<string, size_t> &, map<string, size_t> &);
+  void readGeneSize(map<string, size_t> &);
   size_t genGeneIndex(map<string, size_t> &);
   void setgsz(const string &, size_t);
   void updateGeneSizeFile(map<string, size_t> &);
@@ -91,9 +122,11 @@ struct FileOption {
   string info() const;
 
   string _smFN(const string &, const string &);
+  void _setOutFN();
   void _genTriFNList(const vector<pair<size_t, size_t>> &);
   void _genTriFNList();
 };
 
 string setFilePath(const string &, const string &, const string &);
+void tileOrder(vector<TriFileName> &);
 #endif
\ No newline at end of file
@@ -39,3 +39,41 @@ ostream &operator<<(ostream &os, const CVdimInfo &cdi) {
   os << cdi.len << "\t" << cdi.lasso << "\t" << cdi.norm;
   return os;
 };
+
+// the tails are read only if the file has the expected number of genes
+bool readTails(const string &fname, vector<GeneTail> &gts, size_t n) {
+  gzFile fp;
+  if ((fp = gzopen(fname.c_str(), "rb")) == NULL)
+    return false;
+
+  mlong size(0);
+  bool ok = gzread(fp, (char *)&size, sizeof(mlong)) == int(sizeof(mlong)) &&
+            size == mlong(n);
+  if (ok) {
+    gts.resize(size);
+    int nbyte = sizeof(GeneTail) * size;
+    ok = gzread(fp, (char *)gts.data(), nbyte) == nbyte;
+  }
+  gzclose(fp);
+  return ok;
+};
+
+// the tails are written in a temporary file, and renamed when complete
+void writeTails(const string &fname, const vector<GeneTail> &gts) {
+  string tfile = tmpName(fname);
+  gzFile fp;
+  if ((fp = gzopen(tfile.c_str(), "wb")) == NULL) {
+    cerr << "Error happen on write tail file: " << fname << endl;
+    exit(1);
+  }
+
+  mlong size = gts.size();
+  int nbyte = sizeof(GeneTail) * size;
+  if (gzwrite(fp, &size, sizeof(mlong)) != int(sizeof(mlong)) ||
+      (nbyte > 0 && gzwrite(fp, gts.data(), nbyte) != nbyte) ||
+      gzclose(fp) != Z_OK) {
+    cerr << "Error happen on write tail file: " << fname << endl;
+    exit(1);
+  }
+  renameTo(tfile, fname);
+};
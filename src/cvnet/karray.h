@@ -39,6 +39,7 @@ struct KdimInfo {
 
   KdimInfo() = default;
   KdimInfo(const KdimInfo &rhs): kstr(rhs.kstr), index(rhs.index){};
+  KdimInfo &operator=(const KdimInfo &) = default;
   KdimInfo(const Kstr & ks): kstr(ks), index(0, 0){};
   KdimInfo(const Kstr & ks, size_t i, size_t j): kstr(ks), index(i, j){};
 
@@ -57,10 +58,22 @@ struct CVdimInfo {
 
   CVdimInfo() = default;
   CVdimInfo(const CVdimInfo &rhs): len(rhs.len), lasso(rhs.lasso), norm(rhs.norm){};
+  CVdimInfo &operator=(const CVdimInfo &) = default;
   CVdimInfo(const CVvec&);
 
   friend ostream &operator<<(ostream &, const CVdimInfo &);
 };
 
+// the format of CVA file: the legacy gzip file, the v2 file which is
+// uncompressed by the columns of postings and viewed by mmap, or the version 3
+// file with packed columns
+enum CVAFormat { LEGACY, V2, PACKED };
+
+// the boundary of a gene for deriving the CVA of shorter kmers: the length
+// of gene and the Kstr of its last k-1 residues, or the whole gene if shorter
+typedef pair<size_t, Kstr> GeneTail;
+bool readTails(const string &, vector<GeneTail> &, size_t);
+void writeTails(const string &, const vector<GeneTail> &);
+
 #endif // !KARRAY_H
        // end of karray.h
\ No newline at end of file
@@ -15,6 +15,7 @@
 size_t Kstr::nbase;
 char Kstr::cmap[128];
 vector<char> Kstr::charSet;
+vector<unsigned long> Kstr::units;
 
 int Kstr::init(const vector<char> &letters) {
   nbase = letters.size() + 1;
@@ -24,6 +25,11 @@ int Kstr::init(const vector<char> &letters) {
     cmap[i] = letters[i - 1];
   }
 
+  // the powers of nbase until overflow
+  units.assign(1, 1);
+  while (units.back() <= numeric_limits<unsigned long>::max() / nbase)
+    units.emplace_back(units.back() * nbase);
+
   float logbs = log2(nbase);
   float sz = sizeof(unsigned long) * 8;
   return sz / logbs;
@@ -38,6 +44,11 @@ Kstr::Kstr(const string &str) : ks(0) {
     ks = ks * nbase + cmap[c];
 };
 
+Kstr::Kstr(const GeneView &gene) : ks(0) {
+  for (auto &c : gene)
+    ks = ks * nbase + c;
+};
+
 string Kstr::decode() const {
   if(nbase == 0)
     return "code:" + to_string(ks);
@@ -50,13 +61,7 @@ string Kstr::decode() const {
 }
 
 size_t Kstr::length() const {
-  size_t n(0);
-  unsigned long unit(1);
-  while (unit <= ks) {
-    ++n;
-    unit *= nbase;
-  }
-  return n;
+  return upper_bound(units.begin(), units.end(), ks) - units.begin();
 };
 
 void Kstr::append(char c) {
@@ -64,28 +69,39 @@ void Kstr::append(char c) {
   ks += cmap[c];
 };
 
-void Kstr::addhead(char c) {
-  unsigned long unit(1);
-  while (unit <= ks)
-    unit *= nbase;
-  ks += (unit * cmap[c]);
+void Kstr::append(Residue c) {
+  ks *= nbase;
+  ks += c;
 };
 
+void Kstr::addhead(char c) { ks += units[length()] * cmap[c]; };
+
+void Kstr::addhead(Residue c, size_t k) { ks += units[k] * c; };
+
 void Kstr::choptail() { ks /= nbase; };
 
 void Kstr::behead() {
-  unsigned long unit(1);
-  while (unit <= ks)
-    unit *= nbase;
-  unit /= nbase;
-  ks %= unit;
+  size_t n = length();
+  if (n > 0)
+    ks %= units[n - 1];
 };
 
+void Kstr::behead(size_t k) { ks %= units[k - 1]; };
+
+void Kstr::forward(Residue c, size_t k) {
+  ks = ks % units[k - 1] * nbase + c;
+}
+
 void Kstr::forward(char c) {
   behead();
   append(c);
 }
 
+void Kstr::forward(Residue c) {
+  behead();
+  append(c);
+}
+
 void Kstr::backward(char c) {
   choptail();
   addhead(c);
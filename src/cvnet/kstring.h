@@ -18,6 +18,7 @@
 #include <fstream>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <list>
 #include <map>
 #include <set>
@@ -36,6 +37,7 @@ struct Kstr {
 
   Kstr();
   Kstr(const string &);
+  Kstr(const GeneView &);
   Kstr(unsigned long);
   static int init(const vector<char> &);
 
@@ -43,14 +45,22 @@ struct Kstr {
   size_t length() const;
 
   void append(char);
+  void append(Residue);
   void addhead(char);
 
   void behead();
   void choptail();
 
   void forward(char);
+  void forward(Residue);
   void backward(char);
 
+  // O(1) operations with the length of kstring given
+  void addhead(Residue, size_t);
+  void behead(size_t);
+  void forward(Residue, size_t);
+  Kstr kstr(size_t) const { return *this; };
+
   bool operator<(const Kstr &) const;
   bool operator>(const Kstr &) const;
   bool operator==(const Kstr &) const;
@@ -62,16 +72,94 @@ struct Kstr {
 private:
   static char cmap[128];
   static size_t nbase;
+  static vector<unsigned long> units;
+
+  template <typename A> friend struct PackedKstr;
+};
+
+// the kstring packed by fixed bits per residue for a given alphabet, the
+// residue with index i takes the digit i-1. For a fixed length, the order of
+// packed kstrings is the same as Kstr, which is used in the CV files.
+template <typename A> struct PackedKstr {
+  static constexpr int nbit = A::nbit;
+  static constexpr size_t kmax = (sizeof(mlong) * 8 - 1) / nbit;
+  static constexpr mlong digit = (1UL << nbit) - 1;
+  mlong ks;
+
+  PackedKstr() : ks(0){};
+  PackedKstr(const GeneView &gene) : ks(0) {
+    for (auto &c : gene)
+      append(c);
+  };
+
+  static mlong mask(size_t k) { return (1UL << (nbit * k)) - 1; };
+
+  void append(Residue c) { ks = (ks << nbit) | (c - 1); };
+  void choptail() { ks >>= nbit; };
+  void addhead(Residue c, size_t k) { ks |= mlong(c - 1) << (nbit * k); };
+  Residue head(size_t k) const { return Residue(ks >> (nbit * (k - 1))) + 1; };
+  Residue tail() const { return Residue(ks & digit) + 1; };
+  void behead(size_t k) { ks &= mask(k - 1); };
+  void forward(Residue c, size_t k) {
+    ks = ((ks << nbit) | (c - 1)) & mask(k);
+  };
+
+  // convert to the Kstr with base nbase
+  Kstr kstr(size_t k) const {
+    mlong s(0);
+    for (int sh = nbit * (k - 1); sh >= 0; sh -= nbit)
+      s = s * Kstr::nbase + ((ks >> sh) & digit) + 1;
+    return Kstr(s);
+  };
+
+  bool operator<(const PackedKstr &r) const { return ks < r.ks; };
+  bool operator==(const PackedKstr &r) const { return ks == r.ks; };
 };
 
 struct Kstr_Hash {
-  size_t operator()(const Kstr &r) const { return size_t(r.ks); };
+  template <typename T> size_t operator()(const T &r) const {
+    return size_t(r.ks);
+  };
 };
 
 typedef pair<Kstr, double> CVdim;
 typedef unordered_map<Kstr, double, Kstr_Hash> CVmap;
 typedef vector<CVdim> CVvec;
 
+// the counts of kstring in the space of K: in hash map or sorted vector
+template <typename K> using KCount = unordered_map<K, double, Kstr_Hash>;
+template <typename K> using KVec = vector<pair<K, double>>;
+
+template <typename K> const double *kfind(const KCount<K> &kc, const K &ks) {
+  auto it = kc.find(ks);
+  return it == kc.end() ? nullptr : &(it->second);
+};
+
+template <typename K> const double *kfind(const KVec<K> &kv, const K &ks) {
+  auto it = lower_bound(
+      kv.begin(), kv.end(), ks,
+      [](const pair<K, double> &a, const K &b) { return a.first < b; });
+  return (it == kv.end() || !(it->first == ks)) ? nullptr : &(it->second);
+};
+
+// convert the kstring counts of length k into sorted CV
+template <typename K>
+void kcount2cv(const KCount<K> &kc, size_t k, CVvec &cv) {
+  cv.reserve(cv.size() + kc.size());
+  for (const auto &it : kc)
+    cv.emplace_back(it.first.kstr(k), it.second);
+  sort(cv.begin(), cv.end(),
+       [](const CVdim &a, const CVdim &b) { return a.first < b.first; });
+};
+
+// the sorted kstring counts keep their order in Kstr
+template <typename K>
+void kcount2cv(const KVec<K> &kv, size_t k, CVvec &cv) {
+  cv.reserve(cv.size() + kv.size());
+  for (const auto &it : kv)
+    cv.emplace_back(it.first.kstr(k), it.second);
+};
+
 double module(const CVvec &);
 void normalize(CVvec &);
 
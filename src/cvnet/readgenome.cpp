@@ -29,9 +29,14 @@ void GeneType::init(const string &str) {
   // use the upper case letters
   for(int i=97; i<123; ++i)
     mc[i] = mc[i-32];
+
+  // the index of letters for encoded genome
+  for (int i = 0; i < 128; ++i)
+    mi[i] = find(letters.begin(), letters.end(), mc[i]) - letters.begin() + 1;
 };
 
 void GeneType::aainit() {
+  alphabet = AMINO;
   string aa = "ACDEFGHIKLMNPQRSTVWY";
   // set the default char
   for (auto &c : mc)
@@ -49,6 +54,7 @@ void GeneType::aainit() {
 };
 
 void GeneType::nainit() {
+  alphabet = NUCLEO;
   string na = "ACGT";
   for (auto &c : mc)
     c = na[0];
@@ -77,46 +83,232 @@ void GeneType::nainit() {
   mc['X'] = 'A'; // ACGT
 };
 
-size_t GeneType::readgene(const string &file, Genome &genome) const {
-  ifstream infile(file.c_str());
-  if (!infile) {
+// the blank characters trimmed from the line, as the trim() of stringOpt
+inline bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// scan lines by memchr, call head() for every record and line(b, e) for
+// every trimmed sequence line
+template <typename H, typename L>
+void GeneType::scanfasta(const string &file, H head, L line) const {
+  MMapFile mf;
+  if (!mf.open(file)) {
     cerr << "Cannot found the input file " << file << endl;
     exit(4);
   }
   // cout << " Read file: " << file << endl;
 
-  for (string line; getline(infile, line);) {
-    line = trim(line);
-    if (line.empty() || line[0] == ';') {
+  for (const char *p = mf.begin(); p < mf.end();) {
+    const char *eol = (const char *)memchr(p, '\n', mf.end() - p);
+    if (eol == nullptr)
+      eol = mf.end();
+
+    // trim the line
+    const char *b = p;
+    const char *e = eol;
+    while (b < e && isSpace(*b))
+      ++b;
+    while (e > b && isSpace(*(e - 1)))
+      --e;
+    p = eol + 1;
+
+    if (b == e || *b == ';') {
 
-    } else if (line[0] == '>') {
-      genome.emplace_back();
-    } else if (!genome.empty()) {
-      genome.back().append(line);
+    } else if (*b == '>') {
+      head();
+    } else {
+      line(b, e);
     }
   }
-  infile.close();
+}
+
+size_t GeneType::readgene(const string &file, Genome &genome) const {
+  // translate residues in the same pass of scanning
+  size_t len(0);
+  char tail(0);
+  auto head = [&]() {
+    if (!genome.empty())
+      len += closegene(genome.back(), tail, file);
+    genome.emplace_back();
+    tail = 0;
+  };
+  auto line = [&](const char *b, const char *e) {
+    if (!genome.empty()) {
+      Gene &gene = genome.back();
+      size_t n = gene.size();
+      gene.resize(n + (e - b));
+      for (; b < e; ++b)
+        gene[n++] = mc[*b & 0x7F];
+      tail = *(e - 1);
+    }
+  };
+  scanfasta(file, head, line);
+  if (!genome.empty())
+    len += closegene(genome.back(), tail, file);
 
   if (genome.size() <= 0) {
     cerr << "The genome of " << file << " is empty!" << endl;
     exit(5);
   }
+  return len;
+}
 
+size_t GeneType::readgene(const string &file, GenomeArena &genome) const {
+  // encode residues in the same pass of scanning
   size_t len(0);
-  for (auto &gene : genome) {
-    if (gene.size() == 0) {
-      cerr << "Some empty gene in your genome file: " << file << endl;
-    } else {
-      checkgene(gene);
-      len += gene.size();
+  char tail(0);
+  bool open(false);
+  genome.clear();
+  auto head = [&]() {
+    if (open)
+      len += closegene(genome, tail, file);
+    open = true;
+    tail = 0;
+  };
+  auto line = [&](const char *b, const char *e) {
+    if (open) {
+      encode(b, e, genome.seq);
+      tail = *(e - 1);
+    }
+  };
+  scanfasta(file, head, line);
+  if (open)
+    len += closegene(genome, tail, file);
+
+  if (genome.size() <= 0) {
+    cerr << "The genome of " << file << " is empty!" << endl;
+    exit(5);
+  }
+  genome.seq.shrink_to_fit();
+  return len;
+}
+
+// read genes one by one, only the current gene is kept in memory
+size_t GeneType::eachgene(const string &file,
+                          const function<void(const GeneView &)> &f) const {
+  size_t len(0), ng(0);
+  char tail(0);
+  bool open(false);
+  GenomeArena gene;
+  auto flush = [&]() {
+    len += closegene(gene, tail, file);
+    f(gene[0]);
+    gene.clear();
+    ++ng;
+  };
+  auto head = [&]() {
+    if (open)
+      flush();
+    open = true;
+    tail = 0;
+  };
+  auto line = [&](const char *b, const char *e) {
+    if (open) {
+      encode(b, e, gene.seq);
+      tail = *(e - 1);
     }
+  };
+  scanfasta(file, head, line);
+  if (open)
+    flush();
+
+  if (ng == 0) {
+    cerr << "The genome of " << file << " is empty!" << endl;
+    exit(5);
   }
   return len;
 }
 
+void GeneType::encode(const char *b, const char *e,
+                      vector<Residue> &seq) const {
+  size_t n = seq.size();
+  seq.resize(n + (e - b));
+  Residue *s = seq.data() + n;
+  for (; b < e; ++b)
+    *s++ = mi[*b & 0x7F];
+}
+
+size_t GeneType::closegene(Gene &gene, char tail, const string &file) const {
+  if (gene.size() == 0) {
+    cerr << "Some empty gene in your genome file: " << file << endl;
+    return 0;
+  }
+  // the stop codon or gap at the end of gene
+  if (tail == '*' || tail == '-')
+    gene.pop_back();
+  return gene.size();
+}
+
+size_t GeneType::closegene(GenomeArena &genome, char tail,
+                           const string &file) const {
+  size_t n = genome.seq.size() - genome.offset.back();
+  if (n == 0) {
+    cerr << "Some empty gene in your genome file: " << file << endl;
+  } else if (tail == '*' || tail == '-') {
+    // the stop codon or gap at the end of gene
+    genome.seq.pop_back();
+    --n;
+  }
+  genome.offset.emplace_back(genome.seq.size());
+  return n;
+}
+
 void GeneType::checkgene(string &str) const {
   if (*(str.rbegin()) == '*' || *(str.rbegin()) == '-')
     str.pop_back();
   for (auto &c : str)
-    c = mc[c];
+    c = mc[c & 0x7F];
+};
+
+// the encoded genome
+void GenomeArena::reserve(size_t ng, size_t len) {
+  offset.reserve(ng + 1);
+  seq.reserve(len);
+};
+
+void GenomeArena::append(const GeneView &gene) {
+  seq.insert(seq.end(), gene.begin(), gene.end());
+  offset.emplace_back(seq.size());
+};
+
+size_t GenomeArena::minlen() const {
+  size_t len = size() > 0 ? length() : 0;
+  for (size_t i = 0; i < size(); ++i)
+    len = min(len, offset[i + 1] - offset[i]);
+  return len;
+};
+
+// the hash of the encoded residues and the boundaries of genes, mixed by
+// words and finished by the avalanche of murmur3
+uint64_t GenomeArena::hash() const {
+  uint64_t h(seq.size());
+  auto mix = [&h](uint64_t w) {
+    h ^= w * 0x9E3779B97F4A7C15UL;
+    h = ((h << 27) | (h >> 37)) * 0xC2B2AE3D27D4EB4FUL + 0x165667B19E3779F9UL;
+  };
+  const char *p = (const char *)seq.data();
+  size_t nb = seq.size() * sizeof(Residue);
+  for (; nb >= 8; p += 8, nb -= 8) {
+    uint64_t w;
+    memcpy(&w, p, 8);
+    mix(w);
+  }
+  uint64_t w(0);
+  memcpy(&w, p, nb);
+  mix(w);
+  for (auto &o : offset)
+    mix(o);
+
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDUL;
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53UL;
+  h ^= h >> 33;
+  return h;
+};
+
+void GenomeArena::clear() {
+  seq.clear();
+  offset.assign(1, 0);
 };
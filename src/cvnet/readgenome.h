@@ -13,22 +13,91 @@
 #ifndef READGENOME_H
 #define READGENOME_H
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <vector>
 #include <cctype>
 #include <iomanip>
+#include <cstring>
+#include <functional>
 
+#include "fileOpt.h"
 #include "stringOpt.h"
 using namespace std;
 
 typedef string Gene;
 typedef vector<Gene> Genome;
 
+// the residue encoded by its index in the alphabet of GeneType (from 1)
+typedef unsigned char Residue;
+
+// a gene of the encoded genome, i.e. a view of its residues
+struct GeneView {
+  const Residue *_begin = nullptr;
+  const Residue *_end = nullptr;
+
+  GeneView() = default;
+  GeneView(const Residue *b, const Residue *e) : _begin(b), _end(e){};
+
+  const Residue *begin() const { return _begin; };
+  const Residue *end() const { return _end; };
+  size_t size() const { return _end - _begin; };
+  bool empty() const { return _begin == _end; };
+  Residue operator[](size_t i) const { return _begin[i]; };
+  GeneView head(size_t n) const {
+    return GeneView(_begin, _begin + min(n, size()));
+  };
+};
+
+// the encoded genome: all residues in one buffer with the gene offsets
+struct GenomeArena {
+  vector<Residue> seq;
+  vector<size_t> offset{0};
+
+  struct iterator {
+    const GenomeArena *arena;
+    size_t ndx;
+    GeneView operator*() const { return (*arena)[ndx]; };
+    iterator &operator++() { ++ndx; return *this; };
+    bool operator!=(const iterator &rhs) const { return ndx != rhs.ndx; };
+  };
+
+  size_t size() const { return offset.size() - 1; };
+  size_t length() const { return seq.size(); };
+  size_t minlen() const;
+  bool empty() const { return size() == 0; };
+  GeneView operator[](size_t i) const {
+    return GeneView(seq.data() + offset[i], seq.data() + offset[i + 1]);
+  };
+  iterator begin() const { return iterator{this, 0}; };
+  iterator end() const { return iterator{this, size()}; };
+
+  void reserve(size_t ng, size_t len);
+  void append(const GeneView &);
+  void clear();
+  uint64_t hash() const;
+};
+
+// the alphabets of genome types, for the bit-packed kstring
+struct AminoAcid {
+  static constexpr int nletter = 20;
+  static constexpr int nbit = 5;
+};
+
+struct Nucleotide {
+  static constexpr int nletter = 4;
+  static constexpr int nbit = 2;
+};
+
+enum Alphabet { AMINO, NUCLEO };
+
 struct GeneType{
     char mc[128];
+    Residue mi[128];
     vector<char> letters;
+    enum Alphabet alphabet = AMINO;
     
     GeneType() = default;
     GeneType(const string&);
@@ -38,7 +107,15 @@ struct GeneType{
     void nainit();
 
     size_t readgene(const string&, Genome&) const;
+    size_t readgene(const string&, GenomeArena&) const;
+    size_t eachgene(const string&, const function<void(const GeneView&)>&) const;
+    void encode(const char*, const char*, vector<Residue>&) const;
+    size_t closegene(Gene&, char, const string&) const;
+    size_t closegene(GenomeArena&, char, const string&) const;
     void checkgene(string&) const;
+
+    template <typename H, typename L>
+    void scanfasta(const string&, H, L) const;
 };
 
 #endif
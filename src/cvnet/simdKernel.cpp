@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2025
+ * See the accompanying Manual for the contributors and the way to
+ * cite this work. Comments and suggestions welcome. Please contact
+ * Dr. Guanghong Zuo <ghzuo@ucas.ac.cn>
+ */
+
+#include "simdKernel.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CVNET_X86SIMD
+#include <immintrin.h>
+#endif
+
+SimdKernel theSimd;
+
+/**************************************************************
+ * the scalar kernels, the min is as std::min(va, vb)
+ **************************************************************/
+static void mulAddScalar(float *row, const int *ib, const float *vb, size_t n,
+                         float va) {
+  for (size_t t = 0; t < n; ++t)
+    row[ib[t]] += va * vb[t];
+};
+
+static void minAddScalar(float *row, const int *ib, const float *vb, size_t n,
+                         float va) {
+  for (size_t t = 0; t < n; ++t)
+    row[ib[t]] += vb[t] < va ? vb[t] : va;
+};
+
+#ifdef CVNET_X86SIMD
+/**************************************************************
+ * the kernels by AVX-512: gather the cells, add, and scatter back, with the
+ * mask of the lanes in the block. The masked forms have the zero source, the
+ * plain gather and min of GCC start from an undefined vector, which warns.
+ * The min(b, a) is b < a ? b : a as the scalar one, and the product is added
+ * without fma, so the sums are the same to the scalar kernels
+ **************************************************************/
+template <bool MIN>
+__attribute__((target("avx512f"))) static inline void
+scatter512(float *row, const int *ib, const float *vb, size_t n, float va) {
+  __m512 a = _mm512_set1_ps(va);
+  __m512 zero = _mm512_setzero_ps();
+  for (size_t t = 0; t < n; t += 16) {
+    __mmask16 m = n - t >= 16 ? 0xFFFF : (__mmask16)((1u << (n - t)) - 1);
+    __m512i j = _mm512_maskz_loadu_epi32(m, ib + t);
+    __m512 b = _mm512_maskz_loadu_ps(m, vb + t);
+    __m512 v =
+        MIN ? _mm512_maskz_min_ps(m, b, a) : _mm512_maskz_mul_ps(m, a, b);
+    __m512 r = _mm512_mask_i32gather_ps(zero, m, j, row, 4);
+    _mm512_mask_i32scatter_ps(row, m, j, _mm512_add_ps(r, v), 4);
+  }
+};
+
+__attribute__((target("avx512f"))) static void
+mulAdd512(float *row, const int *ib, const float *vb, size_t n, float va) {
+  scatter512<false>(row, ib, vb, n, va);
+};
+
+__attribute__((target("avx512f"))) static void
+minAdd512(float *row, const int *ib, const float *vb, size_t n, float va) {
+  scatter512<true>(row, ib, vb, n, va);
+};
+
+/**************************************************************
+ * the kernels by AVX2: gather the cells and add, AVX2 has no scatter, so
+ * the sums are stored by lanes
+ **************************************************************/
+template <bool MIN>
+__attribute__((target("avx2"))) static inline void
+scatter256(float *row, const int *ib, const float *vb, size_t n, float va) {
+  __m256 a = _mm256_set1_ps(va);
+  alignas(32) float sum[8];
+  size_t t = 0;
+  for (; t + 8 <= n; t += 8) {
+    __m256i j = _mm256_loadu_si256((const __m256i *)(ib + t));
+    __m256 b = _mm256_loadu_ps(vb + t);
+    __m256 v = MIN ? _mm256_min_ps(b, a) : _mm256_mul_ps(a, b);
+    __m256 r = _mm256_i32gather_ps(row, j, 4);
+    _mm256_store_ps(sum, _mm256_add_ps(r, v));
+    for (int l = 0; l < 8; ++l)
+      row[ib[t + l]] = sum[l];
+  }
+  if (MIN)
+    minAddScalar(row, ib + t, vb + t, n - t, va);
+  else
+    mulAddScalar(row, ib + t, vb + t, n - t, va);
+};
+
+__attribute__((target("avx2"))) static void
+mulAdd256(float *row, const int *ib, const float *vb, size_t n, float va) {
+  scatter256<false>(row, ib, vb, n, va);
+};
+
+__attribute__((target("avx2"))) static void
+minAdd256(float *row, const int *ib, const float *vb, size_t n, float va) {
+  scatter256<true>(row, ib, vb, n, va);
+};
+#endif
+
+/**************************************************************
+ * select the kernels
+ **************************************************************/
+SimdKernel::SimdKernel() { set(best()); };
+
+enum SimdISA SimdKernel::best() const {
+#ifdef CVNET_X86SIMD
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return AVX512;
+  if (__builtin_cpu_supports("avx2"))
+    return AVX2;
+#endif
+  return SCALAR;
+};
+
+void SimdKernel::set(enum SimdISA is) {
+  // the instruction set not supported by the CPU is down to the best one
+  isa = min(is, best());
+  minLen = SIZE_MAX;
+  mulAdd = mulAddScalar;
+  minAdd = minAddScalar;
+#ifdef CVNET_X86SIMD
+  if (isa == AVX512) {
+    minLen = 16;
+    mulAdd = mulAdd512;
+    minAdd = minAdd512;
+  } else if (isa == AVX2) {
+    minLen = 8;
+    mulAdd = mulAdd256;
+    minAdd = minAdd256;
+  }
+#endif
+};
+
+void SimdKernel::set(const string &str) {
+  if (str == "auto") {
+    set(best());
+  } else if (str == "avx512") {
+    set(AVX512);
+  } else if (str == "avx2") {
+    set(AVX2);
+  } else if (str == "scalar") {
+    set(SCALAR);
+  } else {
+    cerr << "Unknow SIMD instruction set: " << str << endl;
+    exit(3);
+  }
+};
+
+string SimdKernel::name() const {
+  if (isa == AVX512)
+    return "AVX-512";
+  if (isa == AVX2)
+    return "AVX2";
+  return "scalar";
+};
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2025
+ * See the accompanying Manual for the contributors and the way to
+ * cite this work. Comments and suggestions welcome. Please contact
+ * Dr. Guanghong Zuo <ghzuo@ucas.ac.cn>
+ */
+
+#ifndef SIMDKERNEL_H
+#define SIMDKERNEL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <string>
+using namespace std;
+
+// the scatter of a block of B into the row of an item of A:
+// row[ib[t]] += f(va, vb[t]). The genes in a block are unique, so the lanes
+// of a vector never hit the same cell of row
+typedef void (*ScatterFunc)(float *, const int *, const float *, size_t,
+                            float);
+
+// the instruction sets with the kernels by gather and scatter, SSE4 has no
+// gather, so it is done by the scalar one
+enum SimdISA { SCALAR, AVX2, AVX512 };
+
+// the kernels of the similarity for the instruction set, selected once from
+// the CPUID at the start of program
+struct SimdKernel {
+  enum SimdISA isa = SCALAR;
+  // the shortest block for the kernels, the shorter ones are by the scalar loop
+  size_t minLen = SIZE_MAX;
+  ScatterFunc mulAdd;
+  ScatterFunc minAdd;
+
+  SimdKernel();
+  void set(enum SimdISA);
+  void set(const string &);
+  enum SimdISA best() const;
+  string name() const;
+};
+
+extern SimdKernel theSimd;
+
+#endif
@@ -24,25 +24,48 @@ MatrixHeader::MatrixHeader(const string &fname) {
   gzclose(fp);
 };
 
+// the header of version 2 starts with the tag line and ends with the
+// threshold of matrix. The legacy one starts with the genome name directly,
+// and its threshold is known only for the full matrix
+const string SMTAG = "#SM2";
+
 void MatrixHeader::read(gzFile &fp) {
   // get the genome name
+  bool v2(false);
   gzline(fp, rowName);
+  if (rowName == SMTAG) {
+    v2 = true;
+    gzline(fp, rowName);
+  }
   gzline(fp, colName);
   // get the matrix size
   gzread(fp, (char *)&(nrow), sizeof(nrow));
   gzread(fp, (char *)&(ncol), sizeof(ncol));
   gzread(fp, (char *)&(nsize), sizeof(nsize));
+  if (v2)
+    gzread(fp, (char *)&(threshold), sizeof(threshold));
+  else if (nsize < 0)
+    threshold = -numeric_limits<float>::infinity();
+  else
+    threshold = NAN;
 };
 
 void MatrixHeader::write(gzFile &fp) const {
   // write the genome information
-  string str = rowName + "\n" + colName + "\n";
+  string str = SMTAG + "\n" + rowName + "\n" + colName + "\n";
   gzputs(fp, str.c_str());
 
   // write the size of CVArray
   gzwrite(fp, &(nrow), sizeof(nrow));
   gzwrite(fp, &(ncol), sizeof(ncol));
   gzwrite(fp, &(nsize), sizeof(nsize));
+  gzwrite(fp, &(threshold), sizeof(threshold));
+};
+
+// the matrix of other genome pair
+void MatrixHeader::transpose() {
+  swap(rowName, colName);
+  swap(nrow, ncol);
 };
 
 ostream &operator<<(ostream &os, const MatrixHeader &hd) {
@@ -86,6 +109,15 @@ void Msimilar::add(size_t i, size_t j, float val) {
   _add(i, j, val);
 };
 
+// the row i for the columns below jend, checked once for a loop on the row
+float *Msimilar::row(size_t i, size_t jend) {
+  if (i >= header.nrow || jend > header.ncol)
+    throw out_of_range("Index " + outIndex(i, jend - 1) + " out of " +
+                       outIndex(header.nrow, header.ncol) +
+                       " in Msimilar::row()");
+  return data.data() + index(i, 0);
+};
+
 void Msimilar::_add(size_t i, size_t j, float val) {
   data[index(i, j)] += val;
 };
@@ -98,6 +130,15 @@ string Msimilar::outIndex(size_t i, size_t j) const {
   return "(" + to_string(i) + ", " + to_string(j) + ")";
 };
 
+void Msimilar::transpose() {
+  vector<float> tmp(data.size());
+  for (size_t i = 0; i < header.nrow; ++i)
+    for (size_t j = 0; j < header.ncol; ++j)
+      tmp[j * header.nrow + i] = data[i * header.ncol + j];
+  data.swap(tmp);
+  header.transpose();
+};
+
 pair<size_t, size_t> Msimilar::index(size_t ndx) const {
   pair<size_t, size_t> tmp;
   tmp.first = ndx / header.ncol;
@@ -119,6 +160,7 @@ void Msimilar::write(const string &fname, float mindist) {
     throw runtime_error("Cannot open file for reading: " + gzfile);
 
   // write data
+  header.threshold = mindist;
   if (mindist < 0.0) {
     // for full matrix
     header.write(fp);
@@ -33,6 +33,7 @@ struct MatrixHeader {
   long nrow = 0;
   long ncol = 0;
   long nsize = -1;
+  float threshold = -numeric_limits<float>::infinity();
 
   MatrixHeader() = default;
   MatrixHeader(long irow, long icol) : nrow(irow), ncol(icol){};
@@ -41,6 +42,7 @@ struct MatrixHeader {
   MatrixHeader(const string &);
   void read(gzFile &);
   void write(gzFile &) const;
+  void transpose();
   friend ostream &operator<<(ostream &, const MatrixHeader &);
 };
 
@@ -59,7 +61,11 @@ struct Msimilar {
   };
   Msimilar(const Msimilar &rhs)
       : header(rhs.header), data(rhs.data.begin(), rhs.data.end()){};
-  Msimilar(const string &fname) { read(fname); }
+  Msimilar(const string &fname, bool trans = false) {
+    read(fname);
+    if (trans)
+      transpose();
+  }
 
   // set row name and col name
   void resetByHeader(const MatrixHeader &, float d0 = 0.0);
@@ -69,11 +75,13 @@ struct Msimilar {
   void set(size_t, size_t, float);
   void _add(size_t, size_t, float);
   void add(size_t, size_t, float);
+  float *row(size_t, size_t);
   float _get(size_t, size_t) const;
   float get(size_t, size_t) const;
   pair<size_t, size_t> index(size_t) const;
   size_t index(size_t, size_t) const;
   string outIndex(size_t, size_t) const;
+  void transpose();
 
   // output info
   string info() const;
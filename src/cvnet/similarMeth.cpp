@@ -12,6 +12,59 @@
 
 #include "similarMeth.h"
 
+/**************************************************************
+ * the cache of CVAs
+ **************************************************************/
+shared_ptr<const CVArray> CVACache::get(const string &fname, enum LPnorm lp) {
+  shared_ptr<const CVArray> cva;
+#pragma omp critical(cvacache)
+  {
+    auto it = ndx.find(fname);
+    if (it != ndx.end()) {
+      lru.splice(lru.begin(), lru, it->second);
+      cva = it->second->second;
+      ++hit;
+    } else {
+      ++miss;
+    }
+  }
+  if (cva)
+    return cva;
+
+  // load out of the lock, a CVA loaded by two threads is cached once
+  cva = make_shared<const CVArray>(fname, lp, dict, maxdf, genes);
+#pragma omp critical(cvacache)
+  {
+    if (ndx.find(fname) == ndx.end()) {
+      lru.emplace_front(fname, cva);
+      ndx[fname] = lru.begin();
+      used += cva->bytes();
+    }
+    // the evicted CVAs are kept by their users until the pair is done
+    while (used > budget && lru.size() > 1) {
+      used -= lru.back().second->bytes();
+      ndx.erase(lru.back().first);
+      lru.pop_back();
+    }
+  }
+  return cva;
+};
+
+void CVACache::clear() {
+  lru.clear();
+  ndx.clear();
+  used = hit = miss = 0;
+};
+
+string CVACache::info() const {
+  size_t n = hit + miss;
+  double ratio = n > 0 ? 100.0 * hit / n : 0.0;
+  ostringstream os;
+  os << "CVA cache hit ratio: " << fixed << setprecision(1) << ratio << "% ("
+     << hit << "/" << n << ")";
+  return os.str();
+};
+
 /**************************************************************
  * the similar methods
  **************************************************************/
@@ -46,239 +99,332 @@ void SimilarMeth::getMatrix(const TriFileName &tf) {
   // get and write down the similar matrix
   Msimilar sm;
   try {
-    CVArray cva(tf.cvfa, lp);
-    CVArray cvb(tf.cvfb, lp);
+    auto cva = cache.get(tf.cvfa, lp);
+    auto cvb = cache.get(tf.cvfb, lp);
+    skipped(cva->post, cvb->post);
     // get the head of matrix
-    MatrixHeader hd(getFileName(tf.cvfa), getFileName(tf.cvfb), cva.norm.size(),
-                    cvb.norm.size());
+    MatrixHeader hd(getFileName(tf.cvfa), getFileName(tf.cvfb),
+                    cva->norm.size(), cvb->norm.size());
+
+    // by rows for the methods where the genes without shared kstr are zero.
+    // The L1 norms of signed values, as Hao's, may cancel in the scale, then
+    // those genes are not zero, so they are left to the dense matrix
+    if (sparse && !cva->signedNorm() && !cvb->signedNorm()) {
+      SMrows smr(hd);
+      calcRows(*cva, *cvb, smr);
+      smr.write(tf.smf, mindist);
+      return;
+    }
+
     sm.resetByHeader(hd);
     // calculate the matrix
-    calcSim(cva, cvb, sm);
+    calcSim(*cva, *cvb, sm);
   } catch (const out_of_range &e) {
     cerr << e.what() << "\nin calculate similar matrix: " << tf.smf << endl;
     exit(2);
   }
   sm.write(tf.smf, mindist);
 
-  // calc and write down RBH
+  // calc and write down RBH, and the RBH for the transposed pair
   GeneRBH rbh(sm);
   rbh.write(tf.smf);
+  sm.transpose();
+  GeneRBH(sm).write(tf.smf, true);
 };
 
-void SimilarMeth::calcSim(const CVArray &cva, const CVArray &cvb,
-                          Msimilar &sm) {
-  vector<pair<size_t, size_t>> aln;
-  alignSortVector(cva.kdi, cvb.kdi, aln);
-
-  for (auto &it : aln) {
-    Kblock kba = cva.getKblock(it.first);
-    Kblock kbb = cvb.getKblock(it.second);
-    _calcOneK(kba, cva.norm, kbb, cvb.norm, sm);
-  }
-
-  for (auto i = 0; i < cva.norm.size(); ++i) {
-    for (auto j = 0; j < cvb.norm.size(); ++j) {
-      sm.set(i, j, scale(sm.get(i, j), cva.norm[i], cvb.norm[j]));
-    }
-  }
-};
-
-///.........................
-/// Three method based on vector
-void Cosine::_calcOneK(const Kblock &blk, const vector<float> &norm,
-                       Msimilar &mtx) {
-  if (blk.size() > 1) {
-    for (auto ita = blk.begin(); ita != blk.end(); ++ita) {
-      for (auto itb = ita + 1; itb != blk.end(); ++itb) {
-        mtx.add(ita->index, itb->index, ita->value * itb->value);
-      }
+// the shared kstrs of the pair dropped by the cap in either genome, and the
+// adds of their blocks
+void SimilarMeth::skipped(const Postings &pa, const Postings &pb) {
+  size_t nk(0), na(0);
+  for (size_t i = 0; i < pa.dkstr.size(); ++i) {
+    size_t m = pb.df(pa.dkstr[i]);
+    if (m > 0) {
+      ++nk;
+      na += pa.dsize[i] * m;
     }
   }
-}
-
-void Cosine::_calcOneK(const Kblock &kba, const vector<float> &na,
-                       const Kblock &kbb, const vector<float> &nb,
-                       Msimilar &mtx) {
-  for (auto ka = kba.begin(); ka != kba.end(); ++ka) {
-    for (auto kb = kbb.begin(); kb != kbb.end(); ++kb) {
-      mtx.add(ka->index, kb->index, ka->value * kb->value);
+  for (size_t i = 0; i < pb.dkstr.size(); ++i) {
+    if (binary_search(pa.dkstr.begin(), pa.dkstr.end(), pb.dkstr[i]))
+      continue;
+    size_t m = pa.df(pb.dkstr[i]);
+    if (m > 0) {
+      ++nk;
+      na += pb.dsize[i] * m;
     }
   }
+#pragma omp atomic
+  skipKstr += nk;
+#pragma omp atomic
+  skipAdd += na;
 };
 
-float Cosine::scale(float val, float aNorm, float bNorm) {
-  return val / (aNorm * bNorm);
-}
-
-void Euclidean::_calcOneK(const Kblock &blk, const vector<float> &norm,
-                          Msimilar &mtx) {
-  // normalize vector and get index for zero item
-  vector<Kitem> blkNorm;
-  for (auto it = blk.begin(); it != blk.end(); ++it)
-    blkNorm.emplace_back(it->index, it->value / norm[it->index]);
-
-  if (blkNorm.size() > 1) {
-    for (auto ita = blkNorm.begin(); ita != blkNorm.end(); ++ita) {
-      for (auto itb = ita + 1; itb != blkNorm.end(); ++itb) {
-        float d = ita->value - itb->value;
-        mtx.add(ita->index, itb->index, d * d);
-      }
-    }
-  }
-}
-
-void Euclidean::_calcOneK(const Kblock &kba, const vector<float> &na,
-                          const Kblock &kbb, const vector<float> &nb,
-                          Msimilar &mtx) {
-  // normalize vector and get index for zero item
-  vector<Kitem> blkA;
-  for (auto it = kba.begin(); it != kba.end(); ++it)
-    blkA.emplace_back(it->index, it->value / na[it->index]);
+string SimilarMeth::skipInfo() const {
+  ostringstream os;
+  os << "skipped " << skipKstr << " shared kstrs and " << skipAdd
+     << " adds by the cap of genes";
+  return os.str();
+};
 
-  vector<Kitem> blkB;
-  for (auto it = kbb.begin(); it != kbb.end(); ++it)
-    blkA.emplace_back(it->index, it->value / nb[it->index]);
+// the shared kstrs by the bitmaps of the dictionary, or by the merge
+void SimilarMeth::align(const CVArray &cva, const CVArray &cvb,
+                        vector<pair<size_t, size_t>> &aln) {
+  if (!cva.post.bits.empty() && cva.post.bits.size() == cvb.post.bits.size())
+    alignByBits(cva.post, cvb.post, aln);
+  else
+    alignSortVector(cva.post.kstr, cvb.post.kstr, aln);
+};
 
-  // for non zero dimension
-  for (auto &ka : blkA) {
-    for (auto &kb : blkB) {
-      float d = ka.value - kb.value;
-      mtx.add(ka.index, kb.index, d * d);
-    }
-  }
+// the scatter of a block of B into a row by the metric, the blocks as long as
+// a vector are by the SIMD kernel for the metrics with one, and others by the
+// loop of compiler
+template <typename M> struct Scatter {
+  static ScatterFunc kernel() { return nullptr; };
+  static void add(float *row, const int *ib, const float *vb, size_t n,
+                  float va) {
+    if (n >= theSimd.minLen && kernel() != nullptr)
+      return kernel()(row, ib, vb, n, va);
+#pragma omp simd
+    for (size_t t = 0; t < n; ++t)
+      row[ib[t]] += M::combine(va, vb[t]);
+  };
 };
 
-float Euclidean::scale(float val, float aNorm, float bNorm) {
-  // for vector a{a1, a2, 0} and b{b1, 0, b3}
-  // d^2 = (a1-b1)^2 + a2^2 + b3^2 = (a1^2 + a2^2) + (b1^2 + b3^2) - 2*a1*b1
-  // d = sqrt(2 - 2 * a1 *b1)
-  return 1 - 0.5 * sqrt(2) * sqrt(1 - val);
-}
+template <> ScatterFunc Scatter<CosineMetric>::kernel() {
+  return theSimd.mulAdd;
+};
 
-// ... distance scaling at L1
+template <> ScatterFunc Scatter<InterListMetric>::kernel() {
+  return theSimd.minAdd;
+};
 
-void InterList::_calcOneK(const Kblock &blk, const vector<float> &norm,
-                          Msimilar &mtx) {
-  if (blk.size() > 1) {
-    for (auto ita = blk.begin(); ita != blk.end(); ++ita) {
-      for (auto itb = ita + 1; itb != blk.end(); ++itb) {
-        mtx.add(ita->index, itb->index, min(ita->value, itb->value));
+/* the row i of the matrix is accumulated from the genes of B in the blocks
+ * of the kstrs of gene i in A, which is in the same order of adds as the
+ * dense matrix. Only the entries kept are stored, so the memory is by the
+ * output. The RBH are picked as GeneRBH on the dense matrix: the first
+ * maximum of a row or column, where the genes without shared kstr count as
+ * zero, and the first of them is the first gap in the touched genes */
+template <typename M>
+void Similar<M>::calcRows(const CVArray &cva, const CVArray &cvb, SMrows &sm) {
+  const Postings &pa = cva.post;
+  const Postings &pb = cvb.post;
+  size_t nrow = sm.header.nrow;
+  size_t ncol = sm.header.ncol;
+  if (nrow == 0 || ncol == 0)
+    return;
+
+  // the blocks of B for the blocks of A
+  vector<pair<size_t, size_t>> aln;
+  align(cva, cvb, aln);
+  vector<int> a2b(pa.kstr.size(), -1);
+  for (auto &it : aln)
+    a2b[it.first] = it.second;
+
+  // the accumulator of a row, and the maxima of rows and columns
+  const float lowest = -numeric_limits<float>::infinity();
+  vector<float> acc(ncol, 0);
+  vector<char> flag(ncol, 0);
+  vector<uint32_t> touched;
+  vector<Edge> rowbest(nrow);
+  vector<float> colmax(ncol, lowest);
+  vector<size_t> colarg(ncol, 0), colcnt(ncol, 0), colnext(ncol, 0);
+  vector<pair<int, float>> blks;
+  for (size_t i = 0; i < nrow; ++i) {
+    // the blocks of B for the row, a row with more adds than columns is done
+    // as a dense one, all genes are touched and their zeros are scaled as the
+    // dense matrix, so the scatter is without the marks of genes
+    size_t nadd(0);
+    for (size_t e = pa.goffset[i]; e < pa.goffset[i + 1]; ++e) {
+      int b = a2b[pa.gblock[e]];
+      if (b >= 0) {
+        blks.emplace_back(b, pa.gvalue[e]);
+        nadd += pb.offset[b + 1] - pb.offset[b];
       }
     }
-  }
-}
-
-void InterList::_calcOneK(const Kblock &kba, const vector<float> &na,
-                          const Kblock &kbb, const vector<float> &nb,
-                          Msimilar &mtx) {
-  for (auto &ka : kba) {
-    for (auto &kb : kbb) {
-      mtx.add(ka.index, kb.index, min(ka.value, kb.value));
+    bool full = nadd >= ncol;
+    for (auto &it : blks) {
+      Kblock kbb = pb.block(it.first);
+      const int *ib = kbb.index();
+      for (size_t t = 0; !full && t < kbb.size(); ++t) {
+        int j = ib[t];
+        if (!flag[j]) {
+          flag[j] = 1;
+          touched.emplace_back(j);
+        }
+      }
+      Scatter<M>::add(acc.data(), ib, kbb.value(), kbb.size(), it.second);
+    }
+    blks.clear();
+    if (full) {
+      touched.resize(ncol);
+      iota(touched.begin(), touched.end(), 0);
+      fill(flag.begin(), flag.end(), 1);
+    } else {
+      sort(touched.begin(), touched.end());
     }
-  }
-};
-
-float InterList::scale(float val, float aNorm, float bNorm) {
-  return 2.0 * val / (aNorm + bNorm);
-}
 
-void Min2Max::_calcOneK(const Kblock &blk, const vector<float> &norm,
-                        Msimilar &mtx) {
-  if (blk.size() > 1) {
-    for (auto ita = blk.begin(); ita != blk.end(); ++ita) {
-      for (auto itb = ita + 1; itb != blk.end(); ++itb) {
-        mtx.add(ita->index, itb->index,
-                min(ita->value, itb->value) / max(ita->value, itb->value));
+    // scale and keep the entries of row
+    float rmax(lowest);
+    size_t rarg(0);
+    for (auto j : touched) {
+      // a gene without norm, such as the one with all kstrs dropped by the
+      // cap, shares nothing, so its entries are zero as the untouched ones
+      // and it is picked for RBH by the first gap
+      float v = cva.norm[i] != 0 && cvb.norm[j] != 0
+                    ? M::scale(acc[j], cva.norm[i], cvb.norm[j])
+                    : 0;
+      acc[j] = v;
+      if (v > rmax) {
+        rmax = v;
+        rarg = j;
+      }
+      if (v != 0 && (mindist < 0 || v >= mindist))
+        sm.data.emplace_back(i * ncol + j, v);
+      if (v > colmax[j]) {
+        colmax[j] = v;
+        colarg[j] = i;
       }
+      ++colcnt[j];
+      if (colnext[j] == i)
+        colnext[j] = i + 1;
     }
-  }
-}
-
-void Min2Max::_calcOneK(const Kblock &kba, const vector<float> &na,
-                        const Kblock &kbb, const vector<float> &nb,
-                        Msimilar &mtx) {
-  for (auto &ka : kba) {
-    for (auto &kb : kbb) {
-      mtx.add(ka.index, kb.index,
-              min(ka.value, kb.value) / max(ka.value, kb.value));
+    if (rmax <= 0) {
+      size_t j0(0);
+      while (j0 < ncol && flag[j0] && acc[j0] != 0)
+        ++j0;
+      if (j0 < ncol) {
+        rmax = 0;
+        rarg = j0;
+      }
     }
-  }
-};
-
-float Min2Max::scale(float val, float aNorm, float bNorm) { return val; }
+    rowbest[i] = Edge(i, rarg, rmax);
 
-// ... distance scaling at L0
-void InterSet::_calcOneK(const Kblock &blk, const vector<float> &norm,
-                         Msimilar &mtx) {
-  if (blk.size() > 1) {
-    for (auto ita = blk.begin(); ita != blk.end(); ++ita) {
-      for (auto itb = ita + 1; itb != blk.end(); ++itb) {
-        mtx.add(ita->index, itb->index, 1);
-      }
+    for (auto j : touched) {
+      acc[j] = 0;
+      flag[j] = 0;
     }
+    touched.clear();
   }
-}
 
-void InterSet::_calcOneK(const Kblock &kba, const vector<float> &na,
-                         const Kblock &kbb, const vector<float> &nb,
-                         Msimilar &mtx) {
-  for (auto &ka : kba) {
-    for (auto &kb : kbb) {
-      mtx.add(ka.index, kb.index, 1.0);
+  // the zeros of columns, and the RBH of the matrix and transposed one
+  for (size_t j = 0; j < ncol; ++j) {
+    if (colcnt[j] < nrow && colmax[j] <= 0) {
+      colarg[j] = colmax[j] < 0 ? colnext[j] : min(colarg[j], colnext[j]);
+      colmax[j] = 0;
     }
   }
+  for (auto &e : rowbest)
+    if (!(colmax[e.index.second] > e.weight) && !isnan(e.weight))
+      sm.rbh.data.emplace_back(e);
+  for (size_t j = 0; j < ncol; ++j)
+    if (!(rowbest[colarg[j]].weight > colmax[j]) && !isnan(colmax[j]))
+      sm.rbt.data.emplace_back(j, colarg[j], colmax[j]);
 };
 
-float InterSet::scale(float val, float aNorm, float bNorm) {
-  return val / sqrt(aNorm * bNorm);
-}
+void SMrows::write(const string &fname, float mindist) {
+  gzFile fp;
+  string gzfile = addsuffix(fname, ".gz");
+  if ((fp = gzopen(gzfile.c_str(), "wb")) == NULL)
+    throw runtime_error("Cannot open file for writing: " + gzfile);
+  header.threshold = mindist;
+  header.nsize = data.size();
+  header.write(fp);
+  gzwrite(fp, data.data(), data.size() * sizeof(data[0]));
+  gzclose(fp);
+
+  rbh.write(fname);
+  rbt.write(fname, true);
+};
 
-void Dice::_calcOneK(const Kblock &blk, const vector<float> &norm,
-                     Msimilar &mtx) {
-  if (blk.size() > 1) {
-    for (auto ita = blk.begin(); ita != blk.end(); ++ita) {
-      for (auto itb = ita + 1; itb != blk.end(); ++itb) {
-        mtx.add(ita->index, itb->index, 1.0);
-      }
-    }
+///.........................
+/// the kernels on the postings: the row of every item in block A is got
+/// once, and the items of block B are scattered into it. The genes in a block
+/// are unique and in order, so the loop on block B has no dependence between
+/// iterations, and the last gene bounds the row checked once
+template <typename M>
+void pairBlock(const Kblock &kba, const Kblock &kbb, Msimilar &mtx) {
+  const int *ib = kbb.index();
+  const float *vb = kbb.value();
+  size_t nb = kbb.size();
+  if (nb == 0)
+    return;
+  size_t jend = ib[nb - 1] + 1;
+  for (size_t a = 0; a < kba.size(); ++a) {
+    float *row = mtx.row(kba.index()[a], jend);
+    Scatter<M>::add(row, ib, vb, nb, kba.value()[a]);
   }
-}
+};
 
-void Dice::_calcOneK(const Kblock &kba, const vector<float> &na,
-                     const Kblock &kbb, const vector<float> &nb,
-                     Msimilar &mtx) {
-  for (auto &ka : kba) {
-    for (auto &kb : kbb) {
-      mtx.add(ka.index, kb.index, 1.0);
-    }
+// scale the sums of the matrix by the norms of genes in place, the RBH are
+// picked on the scaled matrix
+template <typename F>
+void scaleRows(const vector<float> &na, const vector<float> &nb, Msimilar &mtx,
+               F f) {
+  size_t ncol = nb.size();
+  for (size_t i = 0; i < na.size(); ++i) {
+    float *row = mtx.row(i, ncol);
+#pragma omp simd
+    for (size_t j = 0; j < ncol; ++j)
+      row[j] = f(row[j], na[i], nb[j]);
   }
 };
 
-float Dice::scale(float val, float aNorm, float bNorm) {
-  return 2.0 * val / (aNorm + bNorm);
-}
+template <typename M>
+void Similar<M>::calcSim(const CVArray &cva, const CVArray &cvb,
+                         Msimilar &sm) {
+  vector<pair<size_t, size_t>> aln;
+  align(cva, cvb, aln);
+  for (auto &it : aln)
+    pairBlock<M>(cva.getKblock(it.first), cvb.getKblock(it.second), sm);
+  scaleRows(cva.norm, cvb.norm, sm, [](float v, float na, float nb) {
+    return na != 0 && nb != 0 ? M::scale(v, na, nb) : 0;
+  });
+};
 
-void ItoU::_calcOneK(const Kblock &blk, const vector<float> &norm,
-                     Msimilar &mtx) {
-  if (blk.size() > 1) {
-    for (auto ita = blk.begin(); ita != blk.end(); ++ita) {
-      for (auto itb = ita + 1; itb != blk.end(); ++itb) {
-        mtx.add(ita->index, itb->index, 1.0);
-      }
-    }
-  }
-}
+///.........................
+/// Euclidean on the normalized vectors
+void Euclidean::calcSim(const CVArray &cva, const CVArray &cvb,
+                        Msimilar &sm) {
+  vector<pair<size_t, size_t>> aln;
+  align(cva, cvb, aln);
+  for (auto &it : aln)
+    _calcOneK(cva.getKblock(it.first), cva.norm, cvb.getKblock(it.second),
+              cvb.norm, sm);
+  scaleRows(cva.norm, cvb.norm, sm, scale);
+};
 
-void ItoU::_calcOneK(const Kblock &kba, const vector<float> &na,
-                     const Kblock &kbb, const vector<float> &nb,
-                     Msimilar &mtx) {
-  for (auto &ka : kba) {
-    for (auto &kb : kbb) {
-      mtx.add(ka.index, kb.index, 1.0);
-    }
+void Euclidean::_calcOneK(const Kblock &kba, const vector<float> &na,
+                          const Kblock &kbb, const vector<float> &nb,
+                          Msimilar &mtx) {
+  // normalize vector and get index for zero item
+  vector<Kitem> blkA;
+  for (auto it : kba)
+    blkA.emplace_back(it.index, it.value / na[it.index]);
+
+  vector<Kitem> blkB;
+  for (auto it : kbb)
+    blkB.emplace_back(it.index, it.value / nb[it.index]);
+
+  // for non zero dimension, the inner product of the normalized vectors,
+  // which gives the distance in scale()
+  if (blkB.empty())
+    return;
+  size_t jend = blkB.back().index + 1;
+  for (auto &ka : blkA) {
+    float *row = mtx.row(ka.index, jend);
+    for (auto &kb : blkB)
+      row[kb.index] += ka.value * kb.value;
   }
 };
 
-float ItoU::scale(float val, float aNorm, float bNorm) {
-  return val / (aNorm + bNorm - val);
+// the distance of genes without shared kstr is not zero, so it is dense only
+void Euclidean::calcRows(const CVArray &, const CVArray &, SMrows &) {
+  cerr << "Euclidean similarity cannot be calculated by rows" << endl;
+  exit(3);
+};
+
+float Euclidean::scale(float val, float, float) {
+  // for vector a{a1, a2, 0} and b{b1, 0, b3}
+  // d^2 = (a1-b1)^2 + a2^2 + b3^2 = (a1^2 + a2^2) + (b1^2 + b3^2) - 2*a1*b1
+  // d = sqrt(2 - 2 * a1 *b1)
+  return 1 - 0.5 * sqrt(2) * sqrt(1 - val);
 }
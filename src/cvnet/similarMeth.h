@@ -14,9 +14,12 @@
 #define SIMILARMETH_H
 
 #include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <list>
+#include <memory>
 #include <numeric>
 #include <regex>
 #include <set>
@@ -28,112 +31,144 @@
 #include "cvarray.h"
 #include "kit.h"
 #include "similarMatrix.h"
+#include "simdKernel.h"
 #include "edges.h"
 #include "fileOption.h"
 
 using namespace std;
 
+// the CVAs loaded for the similarity, shared by the threads. The least
+// recently used ones are evicted when the memory is over the budget. The
+// items are kept by genes also if genes, for the matrix by rows
+struct CVACache {
+  size_t budget = 0;
+  size_t used = 0;
+  size_t hit = 0;
+  size_t miss = 0;
+  size_t maxdf = 0;
+  bool genes = false;
+  const KDict *dict = nullptr;
+  list<pair<string, shared_ptr<const CVArray>>> lru;
+  unordered_map<string, decltype(lru)::iterator> ndx;
+
+  shared_ptr<const CVArray> get(const string &, enum LPnorm);
+  void clear();
+  string info() const;
+};
+
+// the similar matrix computed by rows, only the entries kept are stored, with
+// the RBH of the matrix and of the transposed one
+struct SMrows {
+  MatrixHeader header;
+  vector<pair<size_t, float>> data;
+  GeneRBH rbh, rbt;
+
+  SMrows(const MatrixHeader &hd) : header(hd), rbh(hd), rbt(hd) {
+    rbt.header.transpose();
+  };
+  void write(const string &, float);
+};
+
 struct SimilarMeth {
   enum LPnorm lp;
   float mindist;
+  CVACache cache;
+  // the genes without shared kstr have zero similarity, so the matrix can be
+  // computed by rows with only the shared genes
+  bool sparse = true;
+  // the shared kstrs skipped by the cap of genes in a block, and their adds
+  size_t skipKstr = 0;
+  size_t skipAdd = 0;
 
   // the create function
   static SimilarMeth *create(const string &, float);
 
   // get the similarity matrix
   void getMatrix(const TriFileName&);
-  void calcSim(const CVArray &, const CVArray &, Msimilar &);
+  void align(const CVArray &, const CVArray &, vector<pair<size_t, size_t>> &);
+  void skipped(const Postings &, const Postings &);
+  string skipInfo() const;
 
-  // the virtual function for different methods
-  virtual void _calcOneK(const Kblock &, const vector<float> &, Msimilar &) = 0;
-  virtual void _calcOneK(const Kblock &, const vector<float> &, const Kblock &,
-                         const vector<float> &, Msimilar &) = 0;
+  // the scaled matrix of a pair, in dense or by rows
+  virtual void calcSim(const CVArray &, const CVArray &, Msimilar &) = 0;
+  virtual void calcRows(const CVArray &, const CVArray &, SMrows &) = 0;
+};
 
-  // scale the value at the end
-  virtual float scale(float, float, float) = 0;
+// the similarity by a metric: the norm of CVA, the combine of the values of
+// a shared kstr, and the scale of the sum by the norms of two genes. The
+// kernels are compiled for every metric
+template <typename M> struct Similar : public SimilarMeth {
+  Similar() { lp = M::lp; };
+  void calcSim(const CVArray &, const CVArray &, Msimilar &) override;
+  void calcRows(const CVArray &, const CVArray &, SMrows &) override;
 };
 
 // ... son class for different method
 // ... distance scaling at L2
-struct Cosine : public SimilarMeth {
-  Cosine() {
-    lp = L2;
+struct CosineMetric {
+  static constexpr enum LPnorm lp = L2;
+  static float combine(float a, float b) { return a * b; };
+  static float scale(float val, float aNorm, float bNorm) {
+    return val / (aNorm * bNorm);
   };
-
-  void _calcOneK(const Kblock &, const vector<float> &, Msimilar &) override;
-  void _calcOneK(const Kblock &, const vector<float> &, const Kblock &,
-                 const vector<float> &, Msimilar &) override;
-  ;
-  float scale(float, float, float) override;
 };
+typedef Similar<CosineMetric> Cosine;
 
 struct Euclidean : public SimilarMeth {
   Euclidean() {
     lp = L2;
+    sparse = false;
   };
 
-  void _calcOneK(const Kblock &, const vector<float> &, Msimilar &) override;
+  void calcSim(const CVArray &, const CVArray &, Msimilar &) override;
+  void calcRows(const CVArray &, const CVArray &, SMrows &) override;
   void _calcOneK(const Kblock &, const vector<float> &, const Kblock &,
-                 const vector<float> &, Msimilar &) override;
-  float scale(float, float, float) override;
-  void zeroItem(const Kblock &, size_t, Msimilar &);
-  void normBLK(const Kblock &, const vector<float> &, vector<Kitem> &);
+                 const vector<float> &, Msimilar &);
+  static float scale(float, float, float);
 };
 
 // ... distance scaling at L1
-struct InterList : public SimilarMeth {
-  InterList() {
-    lp = L1;
+struct InterListMetric {
+  static constexpr enum LPnorm lp = L1;
+  static float combine(float a, float b) { return min(a, b); };
+  static float scale(float val, float aNorm, float bNorm) {
+    return 2.0 * val / (aNorm + bNorm);
   };
-
-  void _calcOneK(const Kblock &, const vector<float> &, Msimilar &) override;
-  void _calcOneK(const Kblock &, const vector<float> &, const Kblock &,
-                 const vector<float> &, Msimilar &) override;
-  float scale(float, float, float) override;
 };
+typedef Similar<InterListMetric> InterList;
 
-struct Min2Max : public SimilarMeth {
-  Min2Max() {
-    lp = L1;
-  };
-
-  void _calcOneK(const Kblock &, const vector<float> &, Msimilar &) override;
-  void _calcOneK(const Kblock &, const vector<float> &, const Kblock &,
-                 const vector<float> &, Msimilar &) override;
-  float scale(float, float, float) override;
+struct Min2MaxMetric {
+  static constexpr enum LPnorm lp = L1;
+  static float combine(float a, float b) { return min(a, b) / max(a, b); };
+  static float scale(float val, float, float) { return val; };
 };
+typedef Similar<Min2MaxMetric> Min2Max;
 
 // ... distance scaling at L0
-struct InterSet : public SimilarMeth {
-  InterSet() {
-    lp = L0;
+struct InterSetMetric {
+  static constexpr enum LPnorm lp = L0;
+  static float combine(float, float) { return 1.0f; };
+  static float scale(float val, float aNorm, float bNorm) {
+    return val / sqrt(aNorm * bNorm);
   };
-
-  void _calcOneK(const Kblock &, const vector<float> &, Msimilar &) override;
-  void _calcOneK(const Kblock &, const vector<float> &, const Kblock &,
-                 const vector<float> &, Msimilar &) override;
-  float scale(float, float, float) override;
 };
+typedef Similar<InterSetMetric> InterSet;
 
-struct Dice : public SimilarMeth {
-  Dice() {
-    lp = L0;
+struct DiceMetric {
+  static constexpr enum LPnorm lp = L0;
+  static float combine(float, float) { return 1.0f; };
+  static float scale(float val, float aNorm, float bNorm) {
+    return 2.0 * val / (aNorm + bNorm);
   };
-
-  void _calcOneK(const Kblock &, const vector<float> &, Msimilar &) override;
-  void _calcOneK(const Kblock &, const vector<float> &, const Kblock &,
-                 const vector<float> &, Msimilar &) override;
-  float scale(float, float, float) override;
 };
+typedef Similar<DiceMetric> Dice;
 
-struct ItoU : public SimilarMeth {
-  ItoU() {
-    lp = L0;
+struct ItoUMetric {
+  static constexpr enum LPnorm lp = L0;
+  static float combine(float, float) { return 1.0f; };
+  static float scale(float val, float aNorm, float bNorm) {
+    return val / (aNorm + bNorm - val);
   };
-
-  void _calcOneK(const Kblock &, const vector<float> &, Msimilar &) override;
-  void _calcOneK(const Kblock &, const vector<float> &, const Kblock &,
-                 const vector<float> &, Msimilar &) override;
-  float scale(float, float, float) override;
 };
-#endif
\ No newline at end of file
+typedef Similar<ItoUMetric> ItoU;
+#endif
@@ -11,6 +11,8 @@
  */
 
 #include "fileOpt.h"
+#include <sys/file.h>
+#include <unistd.h>
 
 /********************************************************************************
  * @brief Options on tar and zlib files
@@ -121,4 +123,72 @@ string nameWithK(const string &str, size_t k) {
     npos += kstr.length();
   }
   return sstr;
-}
\ No newline at end of file
+}
+string tmpName(const string &fname) {
+  return fname + ".tmp" + to_string(getpid());
+};
+
+void renameTo(const string &tfile, const string &fname) {
+  if (rename(tfile.c_str(), fname.c_str()) != 0) {
+    cerr << "Error happen on write file: " << fname << endl;
+    exit(1);
+  }
+};
+
+/********************************************************************************
+ * @brief exclusive lock of a file shared by processes
+ *
+ ********************************************************************************/
+FileLock::FileLock(const string &fname) {
+  fd = ::open((fname + ".lock").c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0 || flock(fd, LOCK_EX) != 0)
+    cerr << "Warning: cannot lock the file " << fname << endl;
+};
+
+FileLock::~FileLock() {
+  if (fd >= 0) {
+    flock(fd, LOCK_UN);
+    ::close(fd);
+  }
+};
+
+/********************************************************************************
+ * @brief read-only memory map of a whole file
+ *
+ ********************************************************************************/
+bool MMapFile::open(const string &fname) {
+  close();
+  int fd = ::open(fname.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    ::close(fd);
+    return false;
+  }
+
+  // an empty file is valid but has nothing to map
+  size = st.st_size;
+  if (size > 0) {
+    void *ptr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (ptr == MAP_FAILED) {
+      ::close(fd);
+      size = 0;
+      return false;
+    }
+    madvise(ptr, size, MADV_SEQUENTIAL);
+    data = (const char *)ptr;
+  }
+  ::close(fd);
+  opened = true;
+  return true;
+};
+
+void MMapFile::close() {
+  if (data != nullptr)
+    munmap((void *)data, size);
+  data = nullptr;
+  size = 0;
+  opened = false;
+};
@@ -17,6 +17,8 @@
 #include <string>
 #include <zlib.h>
 #include <map>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include "stringOpt.h"
 using namespace std;
 
@@ -67,4 +69,44 @@ void mkpath(const string&);
 // replace $ with k value in file name
 string nameWithK(const string &, size_t);
 
+// the temporary name of a file written by this process, which is renamed to
+// the file when complete, so the readers never see a partial file
+string tmpName(const string &);
+void renameTo(const string &, const string &);
+
+/********************************************************************************
+ * @brief exclusive lock of a file shared by processes, by the lock file
+ * aside it, for the read-modify-write of the file
+ *
+ ********************************************************************************/
+struct FileLock {
+  int fd = -1;
+
+  FileLock(const string &);
+  FileLock(const FileLock &) = delete;
+  FileLock &operator=(const FileLock &) = delete;
+  ~FileLock();
+};
+
+/********************************************************************************
+ * @brief read-only memory map of a whole file
+ *
+ ********************************************************************************/
+struct MMapFile {
+  const char *data = nullptr;
+  size_t size = 0;
+  bool opened = false;
+
+  MMapFile() = default;
+  MMapFile(const string &fname) { open(fname); };
+  MMapFile(const MMapFile &) = delete;
+  MMapFile &operator=(const MMapFile &) = delete;
+  ~MMapFile() { close(); };
+
+  bool open(const string &);
+  void close();
+  const char *begin() const { return data; };
+  const char *end() const { return data + size; };
+};
+
 #endif // FILEOPT_H
@@ -17,5 +17,6 @@
 #include "stringOpt.h"
 #include "fileOpt.h"
 #include "ompOpt.h"
+#include "sortOpt.h"
 
 #endif // !KIT_H
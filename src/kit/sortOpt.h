@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2025
+ * Wenzhou Institute, University of Chinese Academy of Sciences.
+ * See the accompanying Manual for the contributors and the way to
+ * cite this work. Comments and suggestions welcome. Please contact
+ * Dr. Guanghong Zuo <ghzuo@ucas.ac.cn>
+ */
+
+#ifndef SORTOPT_H
+#define SORTOPT_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+/********************************************************************************
+ * @brief stable LSD radix sort by the unsigned key of items
+ *
+ * @param vec   the items to be sorted
+ * @param buf   the buffer with same size, reused between calls
+ * @param nbit  the number of low bits of key to be sorted
+ * @param key   the function to get the key of item
+ ********************************************************************************/
+template <typename T, typename F>
+void radixSort(vector<T> &vec, vector<T> &buf, size_t nbit, F key) {
+  // small vector by the insertion of std sort
+  if (vec.size() < 64) {
+    stable_sort(vec.begin(), vec.end(), [&key](const T &a, const T &b) {
+      return key(a) < key(b);
+    });
+    return;
+  }
+
+  const size_t nr = 8;
+  const size_t mask = (1UL << nr) - 1;
+  buf.resize(vec.size());
+  for (size_t sh = 0; sh < nbit; sh += nr) {
+    // count digits, skip the pass with only one digit
+    size_t cnt[(1UL << nr) + 1] = {0};
+    for (const auto &v : vec)
+      ++cnt[((key(v) >> sh) & mask) + 1];
+    if (*max_element(cnt + 1, cnt + (1UL << nr) + 1) == vec.size())
+      continue;
+
+    // scatter by digit
+    for (size_t i = 1; i <= mask; ++i)
+      cnt[i] += cnt[i - 1];
+    for (const auto &v : vec)
+      buf[cnt[(key(v) >> sh) & mask]++] = v;
+    vec.swap(buf);
+  }
+};
+
+// the number of significant bits of a key
+inline size_t nbitOf(uint64_t x) {
+  return x == 0 ? 0 : 64 - __builtin_clzll(x);
+};
+
+#endif // SORTOPT_H
@@ -195,6 +195,22 @@ long getFileSize(const string &filename) {
   return fileInfo.st_size;
 }
 
+long getFileMTime(const string &filename) {
+  struct stat fileInfo;
+  if (stat(filename.c_str(), &fileInfo) != 0)
+    return -1;
+  return fileInfo.st_mtime;
+}
+
+string getRealPath(const string &filename) {
+  char *rp = realpath(filename.c_str(), nullptr);
+  if (rp == nullptr)
+    return filename;
+  string str(rp);
+  free(rp);
+  return str;
+}
+
 bool fileExists(const string &filename) {
   struct stat buffer;
   return (stat(filename.c_str(), &buffer) == 0);
@@ -152,6 +152,8 @@ template <class T> void uniqueWithOrder(vector<T> &list) {
  * @brief function by sys stat
  ********************************************************************************/
 long getFileSize(const string &);
+long getFileMTime(const string &);
+string getRealPath(const string &);
 bool fileExists(const string &);
 bool isDirectory(const string &);
 